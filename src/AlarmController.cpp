@@ -34,6 +34,7 @@ void AlarmController::begin() {
     snoozeEndTime = 0;
     lastToggle = 0;
     patternStep = 0;
+    generation = 0;
     
     DEBUG_PRINTLN("AlarmController initialized");
 }
@@ -50,6 +51,7 @@ void AlarmController::startAlarm(AlarmPattern pattern) {
     patternStep = 0;
     lastToggle = millis();
     buzzerOutput(true);
+    generation++;
     
     DEBUG_PRINTF("Alarm started with pattern %d\n", pattern);
 }
@@ -59,6 +61,7 @@ void AlarmController::stopAlarm() {
     snoozed = false;
     buzzerOutput(false);
     patternStep = 0;
+    generation++;
     
     DEBUG_PRINTLN("Alarm stopped");
 }
@@ -69,6 +72,7 @@ void AlarmController::snooze(uint16_t seconds) {
     snoozed = true;
     snoozeEndTime = millis() + (seconds * 1000UL);
     buzzerOutput(false);
+    generation++;
     
     DEBUG_PRINTF("Alarm snoozed for %d seconds\n", seconds);
 }
@@ -81,6 +85,7 @@ void AlarmController::update() {
             patternStep = 0;
             lastToggle = millis();
             buzzerOutput(true);
+            generation++;
             DEBUG_PRINTLN("Snooze ended, alarm resumed");
         }
         return;
@@ -104,6 +109,14 @@ void AlarmController::update() {
     }
 }
 
+void AlarmController::setEnabled(bool enabled) {
+    // Re-applying the same setting must not invalidate cached replies
+    if (enabled != buzzerEnabled) {
+        buzzerEnabled = enabled;
+        generation++;
+    }
+}
+
 uint16_t AlarmController::getSnoozeRemaining() const {
     if (!snoozed || millis() >= snoozeEndTime) {
         return 0;
@@ -98,13 +98,20 @@ public:
      * @brief Enable or disable buzzer output
      * @param enabled Buzzer enabled state
      */
-    void setEnabled(bool enabled) { buzzerEnabled = enabled; }
+    void setEnabled(bool enabled);
     
     /**
      * @brief Check if buzzer is enabled
      * @return true if enabled
      */
     bool isEnabled() const { return buzzerEnabled; }
+    
+    /**
+     * @brief Get the alarm state generation
+     * @return Counter that changes whenever isActive(), isSnoozed() or
+     *         isEnabled() does
+     */
+    uint32_t getGeneration() const { return generation; }
 
 private:
     bool active;
@@ -116,6 +123,7 @@ private:
     uint32_t snoozeEndTime;
     uint32_t lastToggle;
     uint8_t patternStep;
+    uint32_t generation;        // Bumped on every state change (see getGeneration)
     
     // Pattern timing arrays (on/off pairs in ms)
     static const uint16_t GENTLE_PATTERN[];
@@ -7,214 +7,430 @@
 
 #include "DoseManager.h"
 #include "Storage.h"
+#include <algorithm>
 
-void DoseManager::begin() {
-    doseCount = 0;
-    for (uint8_t i = 0; i < MAX_DOSES; i++) {
-        doses[i] = Dose();
-        doses[i].id = i;
+// Scratch space for sortDoses(): one packed key per dose
+static uint32_t sortKeys[MAX_DOSES];
+
+// Staged replace entries, packed so one sort orders by time then
+// compartment: minute (bits 20-30), compartment (16-19), enabled (15),
+// caller's item index (0-14)
+static uint32_t batchKeys[MAX_DOSES];
+
+#define BATCH_MINUTE(k)         ((MinuteOfDay)((k) >> 20))
+#define BATCH_COMPARTMENT(k)    ((uint8_t)(((k) >> 16) & 0x0F))
+#define BATCH_ENABLED(k)        (((k) >> 15) & 0x01)
+#define BATCH_ITEM(k)           ((uint16_t)((k) & 0x7FFF))
+
+// Copy of the schedule being written by saveToStorage()
+static DoseTable saveSnapshot;
+
+/**
+ * @brief Scoped hold of the schedule mutex
+ */
+class ScheduleLock {
+public:
+    explicit ScheduleLock(SemaphoreHandle_t mutex) : mutex(mutex) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
     }
+    ~ScheduleLock() { xSemaphoreGive(mutex); }
+
+private:
+    SemaphoreHandle_t mutex;
+};
+
+/**
+ * @brief Check if a dose's flags make it due to alert (enabled, not taken)
+ */
+static inline bool isPending(uint8_t flags) {
+    return (flags & (DOSE_FLAG_ENABLED | DOSE_FLAG_TAKEN)) == DOSE_FLAG_ENABLED;
+}
+
+void DoseManager::begin() {
+    table = &tables[0];
+    stagedCount = 0;
+    statusDay = 0;
+    generation = 0;
+    mutex = xSemaphoreCreateMutex();
+    clearAllDoses();
+    dirty = false;
     DEBUG_PRINTLN("DoseManager initialized");
 }
 
-bool DoseManager::addDose(Time12H time) {
-    if (doseCount >= MAX_DOSES) {
+bool DoseManager::addDose(MinuteOfDay time, uint8_t compartment) {
+    ScheduleLock lock(mutex);
+    
+    if (table->count >= MAX_DOSES) {
         DEBUG_PRINTLN("ERROR: Maximum doses reached");
         return false;
     }
     
-    if (!TimeManager::isValidTime(time)) {
+    if (time >= MINUTES_PER_DAY || compartment >= MAX_COMPARTMENTS) {
         DEBUG_PRINTLN("ERROR: Invalid time for dose");
         return false;
     }
     
-    if (!isTimeSlotAvailable(time)) {
+    if (!isTimeSlotAvailable(time, compartment)) {
         DEBUG_PRINTLN("ERROR: Time slot not available (too close to existing dose)");
         return false;
     }
     
-    doses[doseCount].time = time;
-    doses[doseCount].enabled = true;
-    doses[doseCount].taken = false;
-    doses[doseCount].id = doseCount;
-    doseCount++;
-    
-    sortDoses();
+    insertSorted(time, DOSE_FLAG_ENABLED, compartment);
+    enabledCount++;
+    pendingCount++;
+    invalidateCursor();
+    markDirty();
     
     char timeStr[12];
-    TimeManager::formatTime(time, timeStr);
-    DEBUG_PRINTF("Dose added at %s. Total doses: %d\n", timeStr, doseCount);
+    TimeManager::formatTime(toTime12H(time), timeStr);
+    DEBUG_PRINTF("Dose added at %s. Total doses: %d\n", timeStr, table->count);
     
     return true;
 }
 
-bool DoseManager::removeDose(uint8_t index) {
-    if (index >= doseCount) {
+bool DoseManager::removeDose(uint16_t index) {
+    ScheduleLock lock(mutex);
+    
+    if (index >= table->count) {
         DEBUG_PRINTLN("ERROR: Invalid dose index");
         return false;
     }
     
-    // Shift remaining doses
-    for (uint8_t i = index; i < doseCount - 1; i++) {
-        doses[i] = doses[i + 1];
-        doses[i].id = i;
-    }
+    if (table->flags[index] & DOSE_FLAG_ENABLED) enabledCount--;
+    if (table->flags[index] & DOSE_FLAG_TAKEN) takenCount--;
+    if (isPending(table->flags[index])) pendingCount--;
     
-    doseCount--;
-    doses[doseCount] = Dose();
-    doses[doseCount].id = doseCount;
+    eraseAt(index);
+    invalidateCursor();
+    markDirty();
     
-    DEBUG_PRINTF("Dose removed. Remaining doses: %d\n", doseCount);
+    DEBUG_PRINTF("Dose removed. Remaining doses: %d\n", table->count);
     return true;
 }
 
-bool DoseManager::updateDose(uint8_t index, Time12H time) {
-    if (index >= doseCount) {
+bool DoseManager::updateDose(uint16_t index, MinuteOfDay time) {
+    ScheduleLock lock(mutex);
+    
+    if (index >= table->count) {
         DEBUG_PRINTLN("ERROR: Invalid dose index");
         return false;
     }
     
-    if (!TimeManager::isValidTime(time)) {
+    if (time >= MINUTES_PER_DAY) {
         DEBUG_PRINTLN("ERROR: Invalid time for dose");
         return false;
     }
     
-    if (!isTimeSlotAvailable(time, index)) {
+    uint8_t compartment = table->compartments[index];
+    if (!isTimeSlotAvailable(time, compartment, index)) {
         DEBUG_PRINTLN("ERROR: Time slot not available");
         return false;
     }
     
-    doses[index].time = time;
-    sortDoses();
+    // Move the entry to its new sorted position, keeping its flags
+    uint8_t flags = table->flags[index];
+    eraseAt(index);
+    insertSorted(time, flags, compartment);
+    invalidateCursor();
+    markDirty();
     
     char timeStr[12];
-    TimeManager::formatTime(time, timeStr);
+    TimeManager::formatTime(toTime12H(time), timeStr);
     DEBUG_PRINTF("Dose %d updated to %s\n", index, timeStr);
     
     return true;
 }
 
-void DoseManager::setDoseEnabled(uint8_t index, bool enabled) {
-    if (index < doseCount) {
-        doses[index].enabled = enabled;
+void DoseManager::setDoseEnabled(uint16_t index, bool enabled) {
+    ScheduleLock lock(mutex);
+    
+    if (index < table->count && isDoseEnabled(index) != enabled) {
+        if (enabled) {
+            table->flags[index] |= DOSE_FLAG_ENABLED;
+            enabledCount++;
+            if (!isDoseTaken(index)) pendingCount++;
+        } else {
+            table->flags[index] &= ~DOSE_FLAG_ENABLED;
+            enabledCount--;
+            if (!isDoseTaken(index)) pendingCount--;
+        }
+        invalidateCursor();
+        markDirty();
     }
 }
 
-int8_t DoseManager::checkDoseTime(Time12H currentTime) {
-    for (uint8_t i = 0; i < doseCount; i++) {
-        if (doses[i].enabled && !doses[i].taken) {
-            if (TimeManager::isTimeMatch(currentTime, doses[i].time)) {
-                return i;
-            }
+int16_t DoseManager::checkDoseTime(MinuteOfDay currentTime) {
+    // Only doses at exactly this minute can be due
+    for (uint16_t i = lowerBound(currentTime);
+         i < table->count && table->minutes[i] == currentTime; i++) {
+        if (isPending(table->flags[i])) {
+            return i;
         }
     }
     return -1;
 }
 
-void DoseManager::markDoseTaken(uint8_t index) {
-    if (index < doseCount) {
-        doses[index].taken = true;
+void DoseManager::markDoseTaken(uint16_t index) {
+    ScheduleLock lock(mutex);
+    
+    if (index < table->count && !isDoseTaken(index)) {
+        if (isPending(table->flags[index])) pendingCount--;
+        table->flags[index] |= DOSE_FLAG_TAKEN;
+        takenCount++;
+        invalidateCursor();
+        markDirty();
         DEBUG_PRINTF("Dose %d marked as taken\n", index);
     }
 }
 
-bool DoseManager::isDoseTaken(uint8_t index) {
-    if (index < doseCount) {
-        return doses[index].taken;
+bool DoseManager::isDoseTaken(uint16_t index) const {
+    if (index < table->count) {
+        return (table->flags[index] & DOSE_FLAG_TAKEN) != 0;
     }
     return false;
 }
 
-void DoseManager::resetDailyStatus() {
-    for (uint8_t i = 0; i < doseCount; i++) {
-        doses[i].taken = false;
+bool DoseManager::isDoseEnabled(uint16_t index) const {
+    if (index < table->count) {
+        return (table->flags[index] & DOSE_FLAG_ENABLED) != 0;
     }
+    return false;
+}
+
+void DoseManager::resetDailyStatus(uint16_t day) {
+    ScheduleLock lock(mutex);
+    
+    for (uint16_t i = 0; i < table->count; i++) {
+        table->flags[i] &= ~DOSE_FLAG_TAKEN;
+    }
+    takenCount = 0;
+    pendingCount = enabledCount;
+    statusDay = day;
+    invalidateCursor();
+    markDirty();
     DEBUG_PRINTLN("Daily dose status reset");
 }
 
-int8_t DoseManager::getNextDose(Time12H currentTime) {
-    uint16_t currentMinutes = timeToMinutes(currentTime);
-    int8_t nextDose = -1;
-    uint16_t minDiff = 24 * 60 + 1; // More than a day
-    
-    for (uint8_t i = 0; i < doseCount; i++) {
-        if (doses[i].enabled && !doses[i].taken) {
-            uint16_t doseMinutes = timeToMinutes(doses[i].time);
-            uint16_t diff;
-            
-            if (doseMinutes > currentMinutes) {
-                diff = doseMinutes - currentMinutes;
-            } else if (doseMinutes < currentMinutes) {
-                diff = (24 * 60 - currentMinutes) + doseMinutes;
-            } else {
-                // Current time matches dose time
-                return i;
-            }
-            
-            if (diff < minDiff) {
-                minDiff = diff;
-                nextDose = i;
-            }
-        }
+int16_t DoseManager::getNextDose(MinuteOfDay currentTime) {
+    if (!cursorValid || currentTime != cursorMinute) {
+        updateCursor(currentTime);
     }
-    
-    return nextDose;
+    return nextDoseIndex;
 }
 
-int16_t DoseManager::getMinutesUntilNextDose(TimeManager& timeManager) {
-    Time12H currentTime = timeManager.getCurrentTime();
-    int8_t nextDoseIndex = getNextDose(currentTime);
+int16_t DoseManager::getMinutesUntilNextDose(MinuteOfDay currentTime) {
+    int16_t nextIndex = getNextDose(currentTime);
     
-    if (nextDoseIndex < 0) {
+    if (nextIndex < 0) {
         return -1;
     }
     
-    return timeManager.minutesUntil(doses[nextDoseIndex].time);
+    return minutesForward(currentTime, table->minutes[nextIndex]);
 }
 
-Dose* DoseManager::getDose(uint8_t index) {
-    if (index < doseCount) {
-        return &doses[index];
-    }
-    return nullptr;
+void DoseManager::updateCursor(MinuteOfDay currentTime) {
+    nextDoseIndex = findNextDose(currentTime);
+    cursorMinute = currentTime;
+    cursorValid = true;
 }
 
-void DoseManager::sortDoses() {
-    // Simple bubble sort (adequate for small arrays)
-    for (uint8_t i = 0; i < doseCount - 1; i++) {
-        for (uint8_t j = 0; j < doseCount - i - 1; j++) {
-            uint16_t time1 = timeToMinutes(doses[j].time);
-            uint16_t time2 = timeToMinutes(doses[j + 1].time);
-            
-            if (time1 > time2) {
-                Dose temp = doses[j];
-                doses[j] = doses[j + 1];
-                doses[j + 1] = temp;
-            }
+int16_t DoseManager::findNextDose(MinuteOfDay currentTime) const {
+    if (pendingCount == 0) {
+        return -1;
+    }
+    
+    // Start at the first dose at or after now, then walk forward
+    // (wrapping past midnight) to the first pending one
+    uint16_t start = lowerBound(currentTime);
+    
+    for (uint16_t n = 0; n < table->count; n++) {
+        uint16_t i = (start + n) % table->count;
+        if (isPending(table->flags[i])) {
+            return i;
         }
     }
+    return -1;
+}
+
+void DoseManager::loadTable(const DoseTable& source, uint16_t day) {
+    ScheduleLock lock(mutex);
+    
+    *table = source;
+    statusDay = day;
+    if (table->count > MAX_DOSES) {
+        table->count = 0;
+    }
     
-    // Update IDs after sort
-    for (uint8_t i = 0; i < doseCount; i++) {
-        doses[i].id = i;
+    sortDoses();
+    recount();
+    generation++;
+}
+
+void DoseManager::beginReplace() {
+    stagedCount = 0;
+}
+
+DoseBatchError DoseManager::stageDose(uint16_t item, MinuteOfDay time,
+                                      uint8_t compartment, bool enabled) {
+    if (time >= MINUTES_PER_DAY) {
+        return DOSE_BATCH_INVALID_TIME;
     }
+    if (compartment >= MAX_COMPARTMENTS) {
+        return DOSE_BATCH_INVALID_COMPARTMENT;
+    }
+    if (stagedCount >= MAX_DOSES || item > BATCH_ITEM(0xFFFFFFFF)) {
+        return DOSE_BATCH_TOO_MANY;
+    }
+    
+    batchKeys[stagedCount++] = ((uint32_t)time << 20) |
+                               ((uint32_t)compartment << 16) |
+                               ((uint32_t)(enabled ? 1 : 0) << 15) |
+                               item;
+    return DOSE_BATCH_OK;
 }
 
-bool DoseManager::isTimeSlotAvailable(Time12H time, int8_t excludeIndex) {
-    uint16_t newMinutes = timeToMinutes(time);
+uint16_t DoseManager::commitReplace(DoseBatchError* errors) {
+    ScheduleLock lock(mutex);
+    std::sort(batchKeys, batchKeys + stagedCount);
     
-    for (uint8_t i = 0; i < doseCount; i++) {
-        if (i == excludeIndex) continue;
+    // Single sweep: entries of one compartment appear in time order, so
+    // each only needs comparing with that compartment's previous entry
+    int16_t firstIndex[MAX_COMPARTMENTS];
+    int16_t lastIndex[MAX_COMPARTMENTS];
+    for (uint8_t c = 0; c < MAX_COMPARTMENTS; c++) {
+        firstIndex[c] = -1;
+        lastIndex[c] = -1;
+    }
+    
+    uint16_t conflicts = 0;
+    for (uint16_t i = 0; i < stagedCount; i++) {
+        uint8_t c = BATCH_COMPARTMENT(batchKeys[i]);
+        
+        if (lastIndex[c] >= 0 &&
+            BATCH_MINUTE(batchKeys[i]) - BATCH_MINUTE(batchKeys[lastIndex[c]]) < MIN_DOSE_SPACING) {
+            errors[BATCH_ITEM(batchKeys[i])] = DOSE_BATCH_CONFLICT;
+            errors[BATCH_ITEM(batchKeys[lastIndex[c]])] = DOSE_BATCH_CONFLICT;
+            conflicts++;
+        }
         
-        uint16_t existingMinutes = timeToMinutes(doses[i].time);
+        if (firstIndex[c] < 0) {
+            firstIndex[c] = i;
+        }
+        lastIndex[c] = i;
+    }
+    
+    // Spacing also applies across midnight: last dose vs next day's first
+    for (uint8_t c = 0; c < MAX_COMPARTMENTS; c++) {
+        if (firstIndex[c] < 0 || firstIndex[c] == lastIndex[c]) continue;
         
-        // Calculate absolute difference (considering day wrap)
-        uint16_t diff = abs((int16_t)newMinutes - (int16_t)existingMinutes);
-        if (diff > 12 * 60) {
-            diff = 24 * 60 - diff;
+        MinuteOfDay first = BATCH_MINUTE(batchKeys[firstIndex[c]]);
+        MinuteOfDay last = BATCH_MINUTE(batchKeys[lastIndex[c]]);
+        if (minutesForward(last, first) < MIN_DOSE_SPACING) {
+            errors[BATCH_ITEM(batchKeys[firstIndex[c]])] = DOSE_BATCH_CONFLICT;
+            errors[BATCH_ITEM(batchKeys[lastIndex[c]])] = DOSE_BATCH_CONFLICT;
+            conflicts++;
         }
+    }
+    
+    if (conflicts > 0) {
+        stagedCount = 0;
+        DEBUG_PRINTF("Schedule replace rejected: %d conflicts\n", conflicts);
+        return conflicts;
+    }
+    
+    // Build the new schedule in the inactive table, already sorted
+    DoseTable* staged = (table == &tables[0]) ? &tables[1] : &tables[0];
+    for (uint16_t i = 0; i < stagedCount; i++) {
+        staged->minutes[i] = BATCH_MINUTE(batchKeys[i]);
+        staged->compartments[i] = BATCH_COMPARTMENT(batchKeys[i]);
+        staged->flags[i] = BATCH_ENABLED(batchKeys[i]) ? DOSE_FLAG_ENABLED : 0;
+    }
+    staged->count = stagedCount;
+    carryOverTaken(*staged);
+    
+    // Swap it in
+    table = staged;
+    stagedCount = 0;
+    recount();
+    markDirty();
+    
+    DEBUG_PRINTF("Schedule replaced: %d doses\n", table->count);
+    return 0;
+}
+
+void DoseManager::carryOverTaken(DoseTable& target) const {
+    // Merge walk over two tables sorted by (minute, compartment)
+    uint16_t i = 0;
+    uint16_t j = 0;
+    while (i < table->count && j < target.count) {
+        uint32_t a = ((uint32_t)table->minutes[i] << 8) | table->compartments[i];
+        uint32_t b = ((uint32_t)target.minutes[j] << 8) | target.compartments[j];
         
-        if (diff < MIN_DOSE_SPACING) {
+        if (a < b) {
+            i++;
+        } else if (b < a) {
+            j++;
+        } else {
+            target.flags[j] |= table->flags[i] & DOSE_FLAG_TAKEN;
+            i++;
+            j++;
+        }
+    }
+}
+
+const char* DoseManager::getBatchErrorName(DoseBatchError error) {
+    switch (error) {
+        case DOSE_BATCH_OK:                     return "ok";
+        case DOSE_BATCH_INVALID_TIME:           return "invalid_time";
+        case DOSE_BATCH_INVALID_COMPARTMENT:    return "invalid_compartment";
+        case DOSE_BATCH_TOO_MANY:               return "too_many";
+        case DOSE_BATCH_CONFLICT:               return "conflict";
+    }
+    return "unknown";
+}
+
+void DoseManager::sortDoses() {
+    // Pack minute, flags and compartment into one key so a single
+    // std::sort (O(n log n)) reorders all three arrays together
+    for (uint16_t i = 0; i < table->count; i++) {
+        sortKeys[i] = ((uint32_t)table->minutes[i] << 16) |
+                      ((uint32_t)table->compartments[i] << 8) |
+                      table->flags[i];
+    }
+    
+    std::sort(sortKeys, sortKeys + table->count);
+    
+    for (uint16_t i = 0; i < table->count; i++) {
+        table->minutes[i] = sortKeys[i] >> 16;
+        table->compartments[i] = (sortKeys[i] >> 8) & 0xFF;
+        table->flags[i] = sortKeys[i] & 0xFF;
+    }
+    invalidateCursor();
+}
+
+bool DoseManager::isTimeSlotAvailable(MinuteOfDay time, uint8_t compartment,
+                                      int16_t excludeIndex) {
+    uint16_t count = table->count;
+    if (count == 0) {
+        return true;
+    }
+    
+    // Only neighbours within MIN_DOSE_SPACING can conflict: walk outwards
+    // from the insertion point in both directions, wrapping at midnight
+    uint16_t pos = lowerBound(time);
+    
+    for (uint16_t n = 0; n < count; n++) {
+        uint16_t i = (pos + n) % count;
+        if (minutesForward(time, table->minutes[i]) >= MIN_DOSE_SPACING) break;
+        if (i != excludeIndex && table->compartments[i] == compartment) {
+            return false;
+        }
+    }
+    
+    for (uint16_t n = 1; n <= count; n++) {
+        uint16_t i = (pos + count - n) % count;
+        if (minutesForward(table->minutes[i], time) >= MIN_DOSE_SPACING) break;
+        if (i != excludeIndex && table->compartments[i] == compartment) {
             return false;
         }
     }
@@ -223,51 +439,109 @@ bool DoseManager::isTimeSlotAvailable(Time12H time, int8_t excludeIndex) {
 }
 
 void DoseManager::clearAllDoses() {
-    doseCount = 0;
-    for (uint8_t i = 0; i < MAX_DOSES; i++) {
-        doses[i] = Dose();
-        doses[i].id = i;
-    }
+    ScheduleLock lock(mutex);
+    
+    table->count = 0;
+    takenCount = 0;
+    enabledCount = 0;
+    pendingCount = 0;
+    invalidateCursor();
+    markDirty();
     DEBUG_PRINTLN("All doses cleared");
 }
 
-uint8_t DoseManager::getDosesTakenCount() {
-    uint8_t count = 0;
-    for (uint8_t i = 0; i < doseCount; i++) {
-        if (doses[i].taken) count++;
+void DoseManager::recount() {
+    takenCount = 0;
+    enabledCount = 0;
+    pendingCount = 0;
+    for (uint16_t i = 0; i < table->count; i++) {
+        if (table->flags[i] & DOSE_FLAG_ENABLED) enabledCount++;
+        if (table->flags[i] & DOSE_FLAG_TAKEN) takenCount++;
+        if (isPending(table->flags[i])) pendingCount++;
     }
-    return count;
+    invalidateCursor();
+}
+
+uint16_t DoseManager::lowerBound(MinuteOfDay time) const {
+    return std::lower_bound(table->minutes, table->minutes + table->count, time) - table->minutes;
 }
 
-uint8_t DoseManager::getEnabledDosesCount() {
-    uint8_t count = 0;
-    for (uint8_t i = 0; i < doseCount; i++) {
-        if (doses[i].enabled) count++;
+uint16_t DoseManager::lowerBound(MinuteOfDay time, uint8_t compartment) const {
+    // Binary search to the minute, then step over its lower compartments
+    // (at most MAX_COMPARTMENTS share a minute)
+    uint16_t pos = lowerBound(time);
+    while (pos < table->count && table->minutes[pos] == time &&
+           table->compartments[pos] < compartment) {
+        pos++;
     }
-    return count;
+    return pos;
 }
 
-uint16_t DoseManager::timeToMinutes(Time12H time) {
-    uint8_t hour24 = TimeManager::convert12to24(time);
-    return hour24 * 60 + time.minute;
+uint16_t DoseManager::insertSorted(MinuteOfDay time, uint8_t flags, uint8_t compartment) {
+    uint16_t pos = lowerBound(time, compartment);
+    uint16_t tail = table->count - pos;
+    
+    memmove(&table->minutes[pos + 1], &table->minutes[pos], tail * sizeof(table->minutes[0]));
+    memmove(&table->flags[pos + 1], &table->flags[pos], tail);
+    memmove(&table->compartments[pos + 1], &table->compartments[pos], tail);
+    
+    table->minutes[pos] = time;
+    table->flags[pos] = flags;
+    table->compartments[pos] = compartment;
+    table->count++;
+    return pos;
 }
 
-bool DoseManager::timesTooClose(Time12H t1, Time12H t2) {
-    uint16_t min1 = timeToMinutes(t1);
-    uint16_t min2 = timeToMinutes(t2);
+void DoseManager::eraseAt(uint16_t index) {
+    uint16_t tail = table->count - index - 1;
     
-    uint16_t diff = abs((int16_t)min1 - (int16_t)min2);
-    if (diff > 12 * 60) {
-        diff = 24 * 60 - diff;
+    memmove(&table->minutes[index], &table->minutes[index + 1], tail * sizeof(table->minutes[0]));
+    memmove(&table->flags[index], &table->flags[index + 1], tail);
+    memmove(&table->compartments[index], &table->compartments[index + 1], tail);
+    table->count--;
+}
+
+void DoseManager::saveToStorage(Storage& storage) {
+    uint16_t day;
+    {
+        ScheduleLock lock(mutex);
+        saveSnapshot = *table;
+        day = statusDay;
+        dirty = false;
     }
+    storage.saveDoses(saveSnapshot, day);
+}
+
+void DoseManager::loadFromStorage(Storage& storage, uint16_t today) {
+    ScheduleLock lock(mutex);
     
-    return diff < MIN_DOSE_SPACING;
+    table->count = storage.loadDoses(*table, today);
+    statusDay = today;
+    sortDoses();
+    recount();
+    dirty = false;
 }
 
-void DoseManager::saveToStorage(Storage& storage) {
-    // Implementation in Storage class
+void DoseManager::update(Storage& storage) {
+    if (!dirty) return;
+    
+    uint32_t now = millis();
+    if (now - lastChange >= SAVE_QUIET_PERIOD || now - dirtySince >= SAVE_MAX_DELAY) {
+        saveToStorage(storage);
+    }
+}
+
+void DoseManager::flush(Storage& storage) {
+    if (dirty) {
+        saveToStorage(storage);
+    }
 }
 
-void DoseManager::loadFromStorage(Storage& storage) {
-    // Implementation in Storage class
+void DoseManager::markDirty() {
+    generation++;
+    lastChange = millis();
+    if (!dirty) {
+        dirtySince = lastChange;
+        dirty = true;
+    }
 }
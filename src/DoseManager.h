@@ -9,12 +9,23 @@
 #define DOSE_MANAGER_H
 
 #include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "config.h"
 #include "TimeManager.h"
 
 // Forward declaration
 class Storage;
 
+// Per-item result of a bulk schedule replace
+enum DoseBatchError : uint8_t {
+    DOSE_BATCH_OK = 0,
+    DOSE_BATCH_INVALID_TIME,
+    DOSE_BATCH_INVALID_COMPARTMENT,
+    DOSE_BATCH_TOO_MANY,
+    DOSE_BATCH_CONFLICT             // Within MIN_DOSE_SPACING of another dose
+};
+
 class DoseManager {
 public:
     /**
@@ -24,90 +35,171 @@ public:
     
     /**
      * @brief Add a new dose at specified time
-     * @param time Time for the dose
+     * @param time Time of day for the dose
+     * @param compartment Compartment holding the dose
      * @return true if dose added successfully
      */
-    bool addDose(Time12H time);
+    bool addDose(MinuteOfDay time, uint8_t compartment = 0);
     
     /**
      * @brief Remove a dose by index
      * @param index Index of dose to remove
      * @return true if removed successfully
      */
-    bool removeDose(uint8_t index);
+    bool removeDose(uint16_t index);
     
     /**
      * @brief Update a dose's time
      * @param index Index of dose to update
-     * @param time New time for the dose
+     * @param time New time of day for the dose
      * @return true if updated successfully
+     * @note The dose moves to keep the table sorted, so its index may change
      */
-    bool updateDose(uint8_t index, Time12H time);
+    bool updateDose(uint16_t index, MinuteOfDay time);
     
     /**
      * @brief Enable or disable a dose
      * @param index Dose index
      * @param enabled Enable state
      */
-    void setDoseEnabled(uint8_t index, bool enabled);
+    void setDoseEnabled(uint16_t index, bool enabled);
     
     /**
      * @brief Check if current time matches any dose time
-     * @param currentTime Current time to check
+     * @param currentTime Current time of day to check
      * @return Index of matching dose, or -1 if no match
      */
-    int8_t checkDoseTime(Time12H currentTime);
+    int16_t checkDoseTime(MinuteOfDay currentTime);
     
     /**
      * @brief Mark a dose as taken
      * @param index Dose index
      */
-    void markDoseTaken(uint8_t index);
+    void markDoseTaken(uint16_t index);
     
     /**
      * @brief Check if a dose has been taken
      * @param index Dose index
      * @return true if taken
      */
-    bool isDoseTaken(uint8_t index);
+    bool isDoseTaken(uint16_t index) const;
+    
+    /**
+     * @brief Check if a dose is enabled
+     * @param index Dose index
+     * @return true if enabled
+     */
+    bool isDoseEnabled(uint16_t index) const;
+    
+    /**
+     * @brief Get a dose's time
+     * @param index Dose index (must be valid)
+     * @return Minutes since midnight
+     */
+    MinuteOfDay getDoseTime(uint16_t index) const { return table->minutes[index]; }
+    
+    /**
+     * @brief Get a dose's compartment
+     * @param index Dose index (must be valid)
+     * @return Compartment id
+     */
+    uint8_t getDoseCompartment(uint16_t index) const { return table->compartments[index]; }
     
     /**
      * @brief Reset all daily taken status (call at midnight)
+     * @param day Day number the new status belongs to (TimeManager::getDayNumber)
      */
-    void resetDailyStatus();
+    void resetDailyStatus(uint16_t day);
+    
+    /**
+     * @brief Get the day the taken flags belong to
+     * @return Day number (days since 1970-01-01)
+     */
+    uint16_t getStatusDay() const { return statusDay; }
     
     /**
      * @brief Get next upcoming dose
-     * @param currentTime Current time
+     * @param currentTime Current time of day
+     * @return Index of next dose, or -1 if none
+     * @note Cached; only recomputed when the minute or the schedule changes.
+     *       Main loop only: the cache is not locked (see findNextDose)
+     */
+    int16_t getNextDose(MinuteOfDay currentTime);
+    
+    /**
+     * @brief Find the next upcoming dose without using the cache
+     * @param currentTime Current time of day
      * @return Index of next dose, or -1 if none
+     * @note Writes nothing, so the web server task can call it
      */
-    int8_t getNextDose(Time12H currentTime);
+    int16_t findNextDose(MinuteOfDay currentTime) const;
     
     /**
      * @brief Get minutes until next dose
-     * @param timeManager TimeManager reference for calculation
+     * @param currentTime Current time of day
      * @return Minutes until next dose, or -1 if none
+     * @note Main loop only, like getNextDose()
      */
-    int16_t getMinutesUntilNextDose(TimeManager& timeManager);
+    int16_t getMinutesUntilNextDose(MinuteOfDay currentTime);
     
     /**
      * @brief Get dose count
      * @return Number of configured doses
      */
-    uint8_t getDoseCount() const { return doseCount; }
+    uint16_t getDoseCount() const { return table->count; }
     
     /**
-     * @brief Get dose by index
-     * @param index Dose index
-     * @return Pointer to dose, or nullptr if invalid index
+     * @brief Get the dose table
+     * @return Sorted struct-of-arrays dose table
+     */
+    const DoseTable& getTable() const { return *table; }
+    
+    /**
+     * @brief Get the schedule generation
+     * @return Counter that changes whenever the schedule or a taken flag does
+     */
+    uint32_t getGeneration() const { return generation; }
+    
+    /**
+     * @brief Replace the schedule with a saved table
+     * @param source Table to copy (need not be sorted)
+     * @param day Day number the table's taken flags belong to
+     * @note Does not mark the schedule as needing a save
+     */
+    void loadTable(const DoseTable& source, uint16_t day);
+    
+    /**
+     * @brief Start staging a replacement schedule
+     */
+    void beginReplace();
+    
+    /**
+     * @brief Stage one dose of the replacement schedule
+     * @param item Caller's index for this dose (used in error reports)
+     * @param time Time of day for the dose
+     * @param compartment Compartment holding the dose
+     * @param enabled Enable state
+     * @return DOSE_BATCH_OK, or why the dose was not staged
+     */
+    DoseBatchError stageDose(uint16_t item, MinuteOfDay time,
+                             uint8_t compartment = 0, bool enabled = true);
+    
+    /**
+     * @brief Validate the staged schedule and swap it in if it is clean
+     * @param errors Per-item results, indexed by item (caller sized);
+     *               conflicts are marked on both doses
+     * @return Number of spacing conflicts; 0 means the schedule was replaced
+     * @note Taken flags carry over for doses whose time and compartment
+     *       are unchanged. The active schedule is untouched on failure.
      */
-    Dose* getDose(uint8_t index);
+    uint16_t commitReplace(DoseBatchError* errors);
     
     /**
-     * @brief Get all doses array
-     * @return Pointer to doses array
+     * @brief Get a readable name for a batch error
+     * @param error Error code
+     * @return Short lowercase name
      */
-    Dose* getDoses() { return doses; }
+    static const char* getBatchErrorName(DoseBatchError error);
     
     /**
      * @brief Sort doses chronologically
@@ -116,23 +208,49 @@ public:
     
     /**
      * @brief Check if a time slot is available (considering spacing)
-     * @param time Time to check
+     * @param time Time of day to check
+     * @param compartment Compartment the dose would use
      * @param excludeIndex Index to exclude from check (-1 for none)
      * @return true if time slot is available
      */
-    bool isTimeSlotAvailable(Time12H time, int8_t excludeIndex = -1);
+    bool isTimeSlotAvailable(MinuteOfDay time, uint8_t compartment = 0,
+                             int16_t excludeIndex = -1);
     
     /**
-     * @brief Save doses to persistent storage
+     * @brief Save doses and today's taken flags to persistent storage
      * @param storage Storage manager reference
+     * @note Writes a copy taken under the lock: a change made during the
+     *       NVS write marks the schedule dirty again for the next save
      */
     void saveToStorage(Storage& storage);
     
     /**
      * @brief Load doses from persistent storage
      * @param storage Storage manager reference
+     * @param today Current day number; saved taken flags from any other
+     *              day are dropped
      */
-    void loadFromStorage(Storage& storage);
+    void loadFromStorage(Storage& storage, uint16_t today);
+    
+    /**
+     * @brief Write the schedule once edits have settled (call every loop)
+     * @param storage Storage manager reference
+     * @note A burst of edits becomes one write SAVE_QUIET_PERIOD after the
+     *       last change, or SAVE_MAX_DELAY after the first if edits keep coming
+     */
+    void update(Storage& storage);
+    
+    /**
+     * @brief Write pending changes now (call before sleep or restart)
+     * @param storage Storage manager reference
+     */
+    void flush(Storage& storage);
+    
+    /**
+     * @brief Check for changes not yet written to storage
+     * @return true if a save is pending
+     */
+    bool hasUnsavedChanges() const { return dirty; }
     
     /**
      * @brief Clear all doses
@@ -143,32 +261,93 @@ public:
      * @brief Get count of doses taken today
      * @return Number of doses taken
      */
-    uint8_t getDosesTakenCount();
+    uint16_t getDosesTakenCount() const { return takenCount; }
     
     /**
      * @brief Get count of enabled doses
      * @return Number of enabled doses
      */
-    uint8_t getEnabledDosesCount();
+    uint16_t getEnabledDosesCount() const { return enabledCount; }
 
 private:
-    Dose doses[MAX_DOSES];
-    uint8_t doseCount;
+    DoseTable tables[2];        // Active schedule and replace staging area
+    DoseTable* table;           // Active schedule
+    uint16_t stagedCount;
+    
+    // Derived state, updated incrementally so home screen queries are O(1)
+    uint16_t takenCount;
+    uint16_t enabledCount;
+    uint16_t pendingCount;      // Enabled and not yet taken
+    int16_t nextDoseIndex;      // Next pending dose, -1 if none
+    MinuteOfDay cursorMinute;   // Minute nextDoseIndex was computed for
+    bool cursorValid;
+    
+    // Write-behind state: mutations only mark the schedule dirty, update()
+    // does the NVS write from the main loop
+    uint16_t statusDay;         // Day the taken flags belong to
+    bool dirty;
+    uint32_t dirtySince;        // millis() of the first unsaved change
+    uint32_t lastChange;        // millis() of the latest unsaved change
+    uint32_t generation;        // Bumped on every change (see getGeneration)
+    
+    // The web server task edits the schedule while the loop saves it
+    SemaphoreHandle_t mutex;
+    
+    /**
+     * @brief Record a change that needs to reach storage
+     */
+    void markDirty();
+    
+    /**
+     * @brief Force the next-dose cursor to be recomputed on next query
+     */
+    void invalidateCursor() { cursorValid = false; }
+    
+    /**
+     * @brief Recompute the next pending dose for a time of day
+     * @param currentTime Current time of day
+     */
+    void updateCursor(MinuteOfDay currentTime);
+    
+    /**
+     * @brief Recount taken, enabled and pending doses from the table
+     */
+    void recount();
+    
+    /**
+     * @brief Binary search for the first dose at or after a time
+     * @param time Time of day
+     * @return Index of first dose with minutes >= time (count if none)
+     */
+    uint16_t lowerBound(MinuteOfDay time) const;
+    
+    /**
+     * @brief Find where a dose belongs in (minute, compartment) order
+     * @param time Time of day
+     * @param compartment Compartment id
+     * @return Index of the first dose ordered after it (count if none)
+     */
+    uint16_t lowerBound(MinuteOfDay time, uint8_t compartment) const;
+    
+    /**
+     * @brief Insert an entry at its sorted position
+     * @return Index the entry was stored at
+     * @note Same-minute doses are ordered by compartment, as sortDoses()
+     *       and commitReplace() leave them; carryOverTaken() relies on it
+     */
+    uint16_t insertSorted(MinuteOfDay time, uint8_t flags, uint8_t compartment);
     
     /**
-     * @brief Convert Time12H to minutes since midnight
-     * @param time Time to convert
-     * @return Minutes since midnight (0-1439)
+     * @brief Remove an entry, closing the gap
+     * @param index Dose index (must be valid)
      */
-    uint16_t timeToMinutes(Time12H time);
+    void eraseAt(uint16_t index);
     
     /**
-     * @brief Check if two times are within MIN_DOSE_SPACING
-     * @param t1 First time
-     * @param t2 Second time
-     * @return true if times are too close
+     * @brief Copy taken flags from the active schedule into a new one
+     * @param target Sorted schedule about to become active
      */
-    bool timesTooClose(Time12H t1, Time12H t2);
+    void carryOverTaken(DoseTable& target) const;
 };
 
 #endif // DOSE_MANAGER_H
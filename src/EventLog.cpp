@@ -0,0 +1,505 @@
+/**
+ * @file EventLog.cpp
+ * @brief Append-only event log implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "EventLog.h"
+#include <rom/crc.h>
+
+#define SEGMENT_MAGIC       0x50424C33  // "PBL3": CRC-32 header and blocks
+#define SEGMENT_MAGIC_V2    0x50424C32  // "PBL2": XOR header, CRC-8 blocks (read only)
+#define BLOCK_HEADER_V2     2           // Payload length + CRC-8
+
+// Segment header: magic, sequence, oldest live record id, id of the
+// segment's first record, keyframe timestamp, check word
+#define HEADER_WORDS        6
+
+static_assert(EVENT_LOG_HEADER_SIZE == HEADER_WORDS * sizeof(uint32_t), "Segment header size");
+static_assert(EVENT_LOG_BATCH * HISTORY_MAX_RECORD_SIZE < 0xFF, "Block length must fit a byte");
+
+// Whole-segment read buffer and block assembly buffer (used under the mutex)
+static uint8_t segmentBuffer[EVENT_LOG_SEGMENT_SIZE];
+static uint8_t blockBuffer[EVENT_LOG_BLOCK_HEADER + EVENT_LOG_BATCH * HISTORY_MAX_RECORD_SIZE];
+
+// Block check of PBL2 segments
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            if (crc & 0x80) {
+                crc = (crc << 1) ^ 0x07;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+    
+    return crc;
+}
+
+static uint32_t headerCheck(const uint32_t* header) {
+    if (header[0] == SEGMENT_MAGIC) {
+        return crc32_le(0, (const uint8_t*)header, (HEADER_WORDS - 1) * sizeof(uint32_t));
+    }
+    
+    uint32_t check = 0;
+    for (uint8_t i = 0; i < HEADER_WORDS - 1; i++) {
+        check ^= header[i];
+    }
+    return ~check;
+}
+
+bool EventLog::begin() {
+    ready = false;
+    bufferValid = false;
+    damagedBlocks = 0;
+    pendingCount = 0;
+    pendingSince = 0;
+    segmentCount = 0;
+    
+    mutex = xSemaphoreCreateMutex();
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         EVENT_LOG_PARTITION);
+    
+    if (!mutex || !partition) {
+        DEBUG_PRINTLN("ERROR: Event log partition not found");
+        return false;
+    }
+    
+    segmentCount = min(partition->size / EVENT_LOG_SEGMENT_SIZE, (uint32_t)EVENT_LOG_MAX_SEGMENTS);
+    if (segmentCount < 2) {
+        DEBUG_PRINTLN("ERROR: Event log partition too small");
+        return false;
+    }
+    
+    if (!mount()) {
+        DEBUG_PRINTLN("Formatting event log");
+        tailSequence = 0;
+        headEndId = 0;
+        headTimestamp = 0;
+        if (!startSegment(0, 0)) {
+            DEBUG_PRINTLN("ERROR: Event log format failed");
+            return false;
+        }
+    }
+    
+    ready = true;
+    DEBUG_PRINTF("Event log mounted: %lu records in %lu bytes\n", getCount(), getUsedBytes());
+    return true;
+}
+
+void EventLog::append(const LogEntry& entry) {
+    if (!ready) return;
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (pendingCount == 0) {
+        pendingSince = millis();
+    }
+    pending[pendingCount++] = entry;
+    if (pendingCount >= EVENT_LOG_BATCH) {
+        writePending();
+    }
+    xSemaphoreGive(mutex);
+}
+
+void EventLog::update() {
+    if (!ready || pendingCount == 0) return;
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (pendingCount > 0 && millis() - pendingSince >= EVENT_LOG_FLUSH_DELAY) {
+        writePending();
+    }
+    xSemaphoreGive(mutex);
+}
+
+void EventLog::flush() {
+    if (!ready) return;
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    writePending();
+    xSemaphoreGive(mutex);
+}
+
+uint16_t EventLog::read(uint32_t& id, LogEntry* entries, uint16_t maxEntries) {
+    return readRange(0, UINT32_MAX, id, entries, maxEntries);
+}
+
+uint16_t EventLog::readRange(uint32_t from, uint32_t to, uint32_t& id,
+                             LogEntry* entries, uint16_t maxEntries) {
+    if (!ready) return 0;
+    
+    uint16_t count = 0;
+    bool pastRange = false;
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    
+    // Time index: skip whole segments that end before the range
+    uint32_t start = max(firstId, segmentFirstId[findSegmentByTime(from) % segmentCount]);
+    if (id < start) {
+        id = start;
+    }
+    
+    // Flash: decode forward from the keyframe of the segment holding id
+    uint32_t sequence = (id < headEndId) ? findSegment(id) : headSequence + 1;
+    while (!pastRange && count < maxEntries && sequence <= headSequence) {
+        uint16_t usedBytes;
+        uint32_t lastTimestamp;
+        count += decodeSegment(sequence, from, to, id, entries + count, maxEntries - count,
+                               pastRange, usedBytes, lastTimestamp);
+        sequence++;
+        
+        // Records after a damaged block are lost: continue at the next segment
+        if (!pastRange && count < maxEntries) {
+            if (usedBytes < EVENT_LOG_SEGMENT_SIZE && segmentBuffer[usedBytes] != 0xFF) {
+                DEBUG_PRINTF("WARNING: Damaged event log block in segment %lu skipped\n", sequence - 1);
+                damagedBlocks++;
+            }
+            id = (sequence <= headSequence) ? segmentFirstId[sequence % segmentCount] : headEndId;
+        }
+    }
+    
+    // Then anything still in the RAM buffer
+    while (!pastRange && count < maxEntries && id >= headEndId && id < headEndId + pendingCount) {
+        const LogEntry& entry = pending[id - headEndId];
+        if (entry.timestamp > to) {
+            pastRange = true;
+            break;
+        }
+        if (entry.timestamp >= from) {
+            entries[count++] = entry;
+        }
+        id++;
+    }
+    
+    xSemaphoreGive(mutex);
+    return count;
+}
+
+uint32_t EventLog::getFirstId() {
+    return firstId;
+}
+
+uint32_t EventLog::getEndId() {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t end = headEndId + pendingCount;
+    xSemaphoreGive(mutex);
+    return end;
+}
+
+uint32_t EventLog::getCount() {
+    if (!ready) return 0;
+    return getEndId() - firstId;
+}
+
+uint32_t EventLog::getUsedBytes() {
+    if (!ready) return 0;
+    return (headSequence - tailSequence) * EVENT_LOG_SEGMENT_SIZE + headOffset;
+}
+
+void EventLog::clear() {
+    if (!ready) return;
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    
+    // A fresh segment whose header says nothing before it is live
+    pendingCount = 0;
+    startSegment(headSequence + 1, headEndId);
+    
+    xSemaphoreGive(mutex);
+    DEBUG_PRINTLN("Event log cleared");
+}
+
+bool EventLog::mount() {
+    bool found = false;
+    uint32_t sequence, firstValid, segmentFirst, keyTimestamp;
+    uint32_t headFirstValid = 0;
+    
+    // Head: the newest valid segment header
+    for (uint16_t sector = 0; sector < segmentCount; sector++) {
+        segmentFirstId[sector] = 0;
+        segmentKeyTime[sector] = 0;
+        if (!readHeader(sector, sequence, firstValid, segmentFirst, keyTimestamp)) continue;
+        if (sequence % segmentCount != sector) continue;
+        
+        segmentFirstId[sector] = segmentFirst;
+        segmentKeyTime[sector] = keyTimestamp;
+        if (!found || sequence > headSequence) {
+            headSequence = sequence;
+            headFirstValid = firstValid;
+            found = true;
+        }
+    }
+    
+    if (!found) {
+        return false;
+    }
+    
+    // Tail: walk back over the unbroken run of older segments
+    tailSequence = headSequence;
+    while (tailSequence > 0 && headSequence - (tailSequence - 1) < segmentCount) {
+        if (!readHeader((tailSequence - 1) % segmentCount, sequence, firstValid,
+                        segmentFirst, keyTimestamp) ||
+            sequence != tailSequence - 1) {
+            break;
+        }
+        tailSequence--;
+    }
+    firstId = max(segmentFirstId[tailSequence % segmentCount], headFirstValid);
+    
+    // Replay the head segment to find where appending resumes
+    headEndId = segmentFirstId[headSequence % segmentCount];
+    bool pastRange;
+    decodeSegment(headSequence, 0, UINT32_MAX, headEndId, nullptr, 0xFFFF, pastRange,
+                  headOffset, headTimestamp);
+    
+    uint32_t headMagic;
+    memcpy(&headMagic, segmentBuffer, sizeof(headMagic));
+    
+    // A block torn by a power cut ends the segment: carry on in a new one
+    if (headOffset < EVENT_LOG_SEGMENT_SIZE && segmentBuffer[headOffset] != 0xFF) {
+        DEBUG_PRINTLN("WARNING: Damaged event log block, starting a new segment");
+        damagedBlocks++;
+        startSegment(headSequence + 1, firstId);
+    } else if (headMagic != SEGMENT_MAGIC) {
+        // Older format head: keep it readable, append in the current format
+        startSegment(headSequence + 1, firstId);
+    }
+    
+    return true;
+}
+
+bool EventLog::startSegment(uint32_t sequence, uint32_t firstValid) {
+    uint16_t sector = sequence % segmentCount;
+    uint32_t offset = sector * EVENT_LOG_SEGMENT_SIZE;
+    
+    bufferValid = false;
+    if (esp_partition_erase_range(partition, offset, EVENT_LOG_SEGMENT_SIZE) != ESP_OK) {
+        return false;
+    }
+    
+    // The previous head's last timestamp is the keyframe, so deltas stay small
+    uint32_t header[HEADER_WORDS] = { SEGMENT_MAGIC, sequence, firstValid, headEndId, headTimestamp, 0 };
+    header[HEADER_WORDS - 1] = headerCheck(header);
+    if (esp_partition_write(partition, offset, header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    
+    segmentFirstId[sector] = headEndId;
+    segmentKeyTime[sector] = headTimestamp;
+    headSequence = sequence;
+    headOffset = EVENT_LOG_HEADER_SIZE;
+    
+    // The sector just erased held the oldest segment once the ring is full
+    if (sequence - tailSequence >= segmentCount) {
+        tailSequence = sequence - segmentCount + 1;
+    }
+    firstId = max(firstValid, segmentFirstId[tailSequence % segmentCount]);
+    
+    return true;
+}
+
+bool EventLog::readHeader(uint16_t sector, uint32_t& sequence, uint32_t& firstValid,
+                          uint32_t& segmentFirst, uint32_t& keyTimestamp) {
+    uint32_t header[HEADER_WORDS];
+    
+    if (esp_partition_read(partition, sector * EVENT_LOG_SEGMENT_SIZE, header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    
+    if ((header[0] != SEGMENT_MAGIC && header[0] != SEGMENT_MAGIC_V2) ||
+        header[HEADER_WORDS - 1] != headerCheck(header)) {
+        return false;
+    }
+    
+    sequence = header[1];
+    firstValid = header[2];
+    segmentFirst = header[3];
+    keyTimestamp = header[4];
+    return true;
+}
+
+uint16_t EventLog::decodeSegment(uint32_t sequence, uint32_t from, uint32_t to, uint32_t& id,
+                                 LogEntry* entries, uint16_t maxEntries, bool& pastRange,
+                                 uint16_t& usedBytes, uint32_t& lastTimestamp) {
+    uint32_t header[HEADER_WORDS];
+    uint16_t count = 0;
+    
+    pastRange = false;
+    usedBytes = EVENT_LOG_HEADER_SIZE;
+    lastTimestamp = 0;
+    
+    // One sequential read for the whole segment; paged readers walking a
+    // segment find it still buffered from their previous call
+    if (!bufferValid || bufferedSequence != sequence) {
+        bufferValid = false;
+        if (esp_partition_read(partition, (sequence % segmentCount) * EVENT_LOG_SEGMENT_SIZE,
+                               segmentBuffer, EVENT_LOG_SEGMENT_SIZE) != ESP_OK) {
+            return 0;
+        }
+        bufferedSequence = sequence;
+        bufferValid = true;
+    }
+    memcpy(header, segmentBuffer, sizeof(header));
+    
+    uint32_t recordId = header[3];
+    uint32_t timestamp = header[4];
+    uint16_t offset = EVENT_LOG_HEADER_SIZE;
+    bool legacy = (header[0] == SEGMENT_MAGIC_V2);
+    uint8_t blockHeader = legacy ? BLOCK_HEADER_V2 : EVENT_LOG_BLOCK_HEADER;
+    bool stop = false;
+    
+    while (!stop && offset + blockHeader <= EVENT_LOG_SEGMENT_SIZE) {
+        uint8_t length = segmentBuffer[offset];
+        const uint8_t* payload = &segmentBuffer[offset + blockHeader];
+        
+        // 0xFF is erased flash: end of the written part
+        if (length == 0xFF) break;
+        
+        if (length == 0 || offset + blockHeader + length > EVENT_LOG_SEGMENT_SIZE) {
+            break;
+        }
+        
+        // A PBL2 header is only 2 bytes: its last block may end too close
+        // to the segment end for a 4-byte read
+        if (legacy) {
+            if (crc8(payload, length) != segmentBuffer[offset + 1]) break;
+        } else {
+            uint32_t crc;
+            memcpy(&crc, &segmentBuffer[offset + 1], sizeof(crc));
+            if (crc32_le(0, payload, length) != crc) break;
+        }
+        
+        bool damaged = false;
+        for (uint16_t pos = 0; pos < length && !stop; ) {
+            LogEntry entry;
+            size_t used = historyDecode(payload + pos, length - pos, timestamp, entry);
+            if (used == 0) {
+                damaged = true;
+                break;
+            }
+            
+            pos += used;
+            timestamp = entry.timestamp;
+            if (recordId >= id) {
+                // Stop before the first record that does not fit or is past the range
+                if (count >= maxEntries || entry.timestamp > to) {
+                    pastRange = entry.timestamp > to;
+                    stop = true;
+                    break;
+                }
+                if (entry.timestamp >= from) {
+                    if (entries) {
+                        entries[count] = entry;
+                    }
+                    count++;
+                }
+                id = recordId + 1;
+            }
+            recordId++;
+        }
+        
+        if (damaged) break;
+        offset += blockHeader + length;
+    }
+    
+    usedBytes = offset;
+    lastTimestamp = timestamp;
+    if (!stop && id < recordId) {
+        id = recordId;
+    }
+    return count;
+}
+
+uint32_t EventLog::findSegment(uint32_t id) const {
+    // Last segment whose first record is at or before id
+    uint32_t low = tailSequence;
+    uint32_t high = headSequence;
+    
+    while (low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (segmentFirstId[mid % segmentCount] <= id) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    
+    return low;
+}
+
+uint32_t EventLog::findSegmentByTime(uint32_t timestamp) const {
+    // Last segment whose keyframe is before timestamp; earlier segments
+    // only hold records at or before their successor's keyframe
+    uint32_t low = tailSequence;
+    uint32_t high = headSequence;
+    
+    while (low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (segmentKeyTime[mid % segmentCount] < timestamp) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    
+    return low;
+}
+
+void EventLog::writePending() {
+    uint8_t written = 0;
+    
+    while (written < pendingCount) {
+        // Encode as many records as fit in the head segment into one block
+        uint16_t space = EVENT_LOG_SEGMENT_SIZE - headOffset;
+        uint16_t length = 0;
+        uint8_t n = 0;
+        uint32_t timestamp = headTimestamp;
+        
+        while (written + n < pendingCount) {
+            size_t size = historyEncode(pending[written + n], timestamp,
+                                        &blockBuffer[EVENT_LOG_BLOCK_HEADER + length]);
+            if (EVENT_LOG_BLOCK_HEADER + length + size > space) break;
+            
+            length += size;
+            timestamp = pending[written + n].timestamp;
+            n++;
+        }
+        
+        if (n == 0) {
+            // Head is full: the next segment reuses the oldest one's sector
+            if (!startSegment(headSequence + 1, firstId)) {
+                DEBUG_PRINTLN("ERROR: Event log segment erase failed");
+                break;
+            }
+            continue;
+        }
+        
+        uint32_t crc = crc32_le(0, &blockBuffer[EVENT_LOG_BLOCK_HEADER], length);
+        blockBuffer[0] = length;
+        memcpy(&blockBuffer[1], &crc, sizeof(crc));
+        
+        uint32_t offset = (headSequence % segmentCount) * EVENT_LOG_SEGMENT_SIZE + headOffset;
+        bufferValid = false;
+        if (esp_partition_write(partition, offset, blockBuffer,
+                                EVENT_LOG_BLOCK_HEADER + length) == ESP_OK) {
+            headOffset += EVENT_LOG_BLOCK_HEADER + length;
+        } else {
+            // Readers stop at the damaged block: continue in a new segment
+            DEBUG_PRINTLN("ERROR: Event log write failed");
+            headOffset = EVENT_LOG_SEGMENT_SIZE;
+        }
+        
+        headEndId += n;
+        headTimestamp = timestamp;
+        written += n;
+    }
+    
+    if (written < pendingCount) {
+        DEBUG_PRINTF("WARNING: Dropped %d log records\n", pendingCount - written);
+    }
+    pendingCount = 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file EventLog.h
+ * @brief Append-only event log in a dedicated flash partition
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "HistoryCodec.h"
+
+#define EVENT_LOG_HEADER_SIZE   24
+#define EVENT_LOG_BLOCK_HEADER  5       // Payload length + CRC-32
+
+/**
+ * @brief Segmented append-only log
+ *
+ * The partition is a ring of segments, one erase sector each. A segment
+ * starts with a small header (magic, sequence, oldest live record, id of
+ * its first record, keyframe timestamp, CRC-32), followed by blocks written
+ * in order. Each block is one batched write: payload length, CRC-32, and
+ * records in the HistoryCodec format, delta-coded from the segment's
+ * keyframe. Head and tail are recovered at mount from the segment
+ * headers, and a record id is found by picking its segment and decoding
+ * from the keyframe. When the ring is full, the oldest segment is erased.
+ * A block failing its CRC ends its segment for readers; they continue at
+ * the next segment and count it in getDamagedBlocks(). Segments in the
+ * older CRC-8 format stay readable until they are recycled.
+ *
+ * Appends are buffered in RAM and written EVENT_LOG_BATCH at a time
+ * (or after EVENT_LOG_FLUSH_DELAY). Safe to use from the web server task.
+ */
+class EventLog {
+public:
+    /**
+     * @brief Find and mount the log partition (formats it if blank)
+     * @return true if the log is usable
+     */
+    bool begin();
+    
+    /**
+     * @brief Check if the log partition was mounted
+     * @return true if ready
+     */
+    bool isReady() const { return ready; }
+    
+    /**
+     * @brief Append an entry (buffered)
+     * @param entry Entry to log
+     */
+    void append(const LogEntry& entry);
+    
+    /**
+     * @brief Write buffered entries once they are old enough (call every loop)
+     */
+    void update();
+    
+    /**
+     * @brief Write buffered entries now (call before sleep or restart)
+     */
+    void flush();
+    
+    /**
+     * @brief Read entries in order, starting at a record id
+     * @param id Record id to start at; advanced past the records consumed
+     * @param entries Array to fill
+     * @param maxEntries Maximum entries to return
+     * @return Number of entries returned
+     * @note Ids older than getFirstId() are skipped; damaged records are dropped
+     */
+    uint16_t read(uint32_t& id, LogEntry* entries, uint16_t maxEntries);
+    
+    /**
+     * @brief Read entries in a time range, in order
+     * @param from First timestamp wanted (inclusive)
+     * @param to Last timestamp wanted (inclusive)
+     * @param id Resume point (0 to start at the range); advanced past the
+     *           records consumed
+     * @param entries Array to fill
+     * @param maxEntries Maximum entries to return
+     * @return Number of entries returned; fewer than maxEntries means the
+     *         range is exhausted
+     * @note Segment keyframes act as a sparse time index, so only the
+     *       segments overlapping the range are read. Assumes timestamps
+     *       increase; records logged after the clock was set back can end
+     *       a range early.
+     */
+    uint16_t readRange(uint32_t from, uint32_t to, uint32_t& id,
+                       LogEntry* entries, uint16_t maxEntries);
+    
+    /**
+     * @brief Get the id of the oldest stored record
+     * @return Record id
+     */
+    uint32_t getFirstId();
+    
+    /**
+     * @brief Get the id the next appended record will get
+     * @return Record id
+     */
+    uint32_t getEndId();
+    
+    /**
+     * @brief Get the number of stored records
+     * @return Record count (including buffered ones)
+     */
+    uint32_t getCount();
+    
+    /**
+     * @brief Get the bytes of flash holding records
+     * @return Used bytes (headers and block overhead included)
+     */
+    uint32_t getUsedBytes();
+    
+    /**
+     * @brief Get the damaged blocks met so far
+     * @return Blocks found failing their CRC (by mount and by reads, so one
+     *         block can count more than once)
+     */
+    uint32_t getDamagedBlocks() const { return damagedBlocks; }
+    
+    /**
+     * @brief Drop all records (erases a single segment)
+     */
+    void clear();
+
+private:
+    const esp_partition_t* partition;
+    SemaphoreHandle_t mutex;
+    bool ready;
+    
+    uint16_t segmentCount;
+    uint32_t tailSequence;      // Oldest segment
+    uint32_t headSequence;      // Segment being written
+    uint16_t headOffset;        // Next free byte in the head segment
+    uint32_t headEndId;         // Id the next record written to flash gets
+    uint32_t headTimestamp;     // Last timestamp written (delta base)
+    uint32_t firstId;           // Oldest readable record
+    uint32_t damagedBlocks;
+    uint32_t bufferedSequence;  // Segment held in the shared segment buffer
+    bool bufferValid;
+    
+    uint32_t segmentFirstId[EVENT_LOG_MAX_SEGMENTS];    // By sector
+    uint32_t segmentKeyTime[EVENT_LOG_MAX_SEGMENTS];    // Keyframes, by sector
+    
+    LogEntry pending[EVENT_LOG_BATCH];
+    uint8_t pendingCount;
+    uint32_t pendingSince;      // millis() of the oldest buffered record
+    
+    /**
+     * @brief Recover head and tail from the segment headers
+     * @return true if a valid log was found
+     */
+    bool mount();
+    
+    /**
+     * @brief Erase the next segment's sector, write its header, make it head
+     * @param sequence Segment sequence number
+     * @param firstValid Oldest live record id when the segment starts
+     * @return true on success
+     */
+    bool startSegment(uint32_t sequence, uint32_t firstValid);
+    
+    /**
+     * @brief Read a segment header
+     * @param sector Sector index
+     * @param sequence Output segment sequence
+     * @param firstValid Output oldest live record id
+     * @param segmentFirst Output id of the segment's first record
+     * @param keyTimestamp Output keyframe timestamp
+     * @return true if the header is valid
+     */
+    bool readHeader(uint16_t sector, uint32_t& sequence, uint32_t& firstValid,
+                    uint32_t& segmentFirst, uint32_t& keyTimestamp);
+    
+    /**
+     * @brief Decode a segment into the shared segment buffer
+     * @param sequence Segment sequence number
+     * @param from First timestamp to return
+     * @param to Last timestamp to return
+     * @param id First record id wanted; advanced past records consumed
+     * @param entries Array to fill (nullptr to only count)
+     * @param maxEntries Maximum entries to return
+     * @param pastRange Output true if a record after 'to' was reached
+     * @param usedBytes Output bytes of the segment holding valid blocks
+     * @param lastTimestamp Output timestamp of the last decoded record
+     * @return Number of entries returned
+     * @note Stops at erased flash or the first damaged block
+     */
+    uint16_t decodeSegment(uint32_t sequence, uint32_t from, uint32_t to, uint32_t& id,
+                           LogEntry* entries, uint16_t maxEntries, bool& pastRange,
+                           uint16_t& usedBytes, uint32_t& lastTimestamp);
+    
+    /**
+     * @brief Find the segment holding a record
+     * @param id Record id (must be live)
+     * @return Segment sequence number
+     */
+    uint32_t findSegment(uint32_t id) const;
+    
+    /**
+     * @brief Find the first segment that can hold records at or after a time
+     * @param timestamp Unix timestamp
+     * @return Segment sequence number
+     */
+    uint32_t findSegmentByTime(uint32_t timestamp) const;
+    
+    /**
+     * @brief Write the RAM buffer to flash (mutex must be held)
+     */
+    void writePending();
+};
+
+#endif // EVENT_LOG_H
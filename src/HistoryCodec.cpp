@@ -0,0 +1,63 @@
+/**
+ * @file HistoryCodec.cpp
+ * @brief Compact history encoding implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "HistoryCodec.h"
+
+static size_t putVarint(uint32_t value, uint8_t* out) {
+    size_t length = 0;
+    
+    while (value >= 0x80) {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+    
+    return length;
+}
+
+static size_t getVarint(const uint8_t* in, size_t length, uint32_t& value) {
+    value = 0;
+    
+    // At most 5 bytes for 32 bits
+    for (size_t i = 0; i < length && i < 5; i++) {
+        value |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    
+    return 0;
+}
+
+size_t historyEncode(const LogEntry& entry, uint32_t previous, uint8_t* out) {
+    int32_t delta = (int32_t)(entry.timestamp - previous);
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    
+    // HISTORY_NO_DOSE + 1 wraps to 0
+    uint32_t event = ((uint32_t)(uint16_t)(entry.doseIndex + 1) << 1) | (entry.wasOnTime ? 1 : 0);
+    
+    size_t length = putVarint(zigzag, out);
+    length += putVarint(event, out + length);
+    return length;
+}
+
+size_t historyDecode(const uint8_t* in, size_t length, uint32_t previous, LogEntry& entry) {
+    uint32_t zigzag, event;
+    
+    size_t used = getVarint(in, length, zigzag);
+    if (used == 0) return 0;
+    
+    size_t eventLength = getVarint(in + used, length - used, event);
+    if (eventLength == 0 || event > 0x1FFFF) return 0;
+    
+    int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    entry.timestamp = previous + (uint32_t)delta;
+    entry.doseIndex = (uint16_t)((event >> 1) - 1);
+    entry.wasOnTime = (event & 1) != 0;
+    
+    return used + eventLength;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file HistoryCodec.h
+ * @brief Compact encoding for adherence history records
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * A record is two varints (LEB128, 7 bits per byte):
+ * - timestamp delta against the previous record, zigzag encoded so a
+ *   clock set backwards still round-trips
+ * - event: (dose index + 1) << 1 | on-time flag, 0 for no dose
+ *
+ * Lid openings hours apart with a low dose index take 4 bytes.
+ * Decoding needs the previous timestamp, so a stream starts from an
+ * absolute keyframe (the event log stores one per segment).
+ *
+ * No Arduino dependencies, so the codec also builds on a host.
+ */
+
+#ifndef HISTORY_CODEC_H
+#define HISTORY_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HISTORY_MAX_RECORD_SIZE     8       // 5-byte delta + 3-byte event
+#define HISTORY_NO_DOSE             0xFFFF
+
+// Log entry structure
+struct LogEntry {
+    uint32_t timestamp;     // Unix timestamp
+    uint16_t doseIndex;     // Which dose was taken (0xFFFF if none)
+    bool wasOnTime;         // Was it taken on time
+};
+
+/**
+ * @brief Encode one record
+ * @param entry Entry to encode
+ * @param previous Timestamp of the previous record (or the keyframe)
+ * @param out Buffer of at least HISTORY_MAX_RECORD_SIZE bytes
+ * @return Bytes written
+ */
+size_t historyEncode(const LogEntry& entry, uint32_t previous, uint8_t* out);
+
+/**
+ * @brief Decode one record
+ * @param in Encoded bytes
+ * @param length Bytes available
+ * @param previous Timestamp of the previous record (or the keyframe)
+ * @param entry Output entry
+ * @return Bytes consumed, or 0 if the input is truncated or malformed
+ */
+size_t historyDecode(const uint8_t* in, size_t length, uint32_t previous, LogEntry& entry);
+
+#endif // HISTORY_CODEC_H
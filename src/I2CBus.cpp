@@ -0,0 +1,94 @@
+/**
+ * @file I2CBus.cpp
+ * @brief Shared I2C bus scheduler implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "I2CBus.h"
+
+I2CBus i2cBus;
+
+static portMUX_TYPE waiterMux = portMUX_INITIALIZER_UNLOCKED;
+
+bool I2CBus::begin(uint8_t sda, uint8_t scl, uint32_t busClock) {
+    mutex = xSemaphoreCreateMutex();
+    priorityWaiters = 0;
+    owner = I2C_DEVICE_COUNT;
+    acquiredAt = 0;
+    clock = busClock;
+    memset(stats, 0, sizeof(stats));
+    
+    if (!mutex || !Wire.begin(sda, scl, clock)) {
+        DEBUG_PRINTLN("ERROR: I2C bus initialization failed");
+        return false;
+    }
+    
+    DEBUG_PRINTF("I2C bus started at %lu Hz\n", clock);
+    return true;
+}
+
+void I2CBus::acquire(I2CDevice device, I2CPriority priority) {
+    uint32_t start = micros();
+    
+    if (priority == I2C_PRIORITY_HIGH) {
+        portENTER_CRITICAL(&waiterMux);
+        priorityWaiters++;
+        portEXIT_CRITICAL(&waiterMux);
+    } else {
+        // Let queued high-priority transactions go first
+        while (priorityWaiters > 0) {
+            vTaskDelay(1);
+        }
+    }
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    
+    if (priority == I2C_PRIORITY_HIGH) {
+        portENTER_CRITICAL(&waiterMux);
+        priorityWaiters--;
+        portEXIT_CRITICAL(&waiterMux);
+    }
+    
+    owner = device;
+    acquiredAt = micros();
+    
+    uint32_t waited = acquiredAt - start;
+    if (waited > stats[device].maxWaitUs) {
+        stats[device].maxWaitUs = waited;
+    }
+}
+
+void I2CBus::release() {
+    uint32_t held = micros() - acquiredAt;
+    
+    if (owner < I2C_DEVICE_COUNT) {
+        I2CDeviceStats& s = stats[owner];
+        s.transactions++;
+        s.busTimeUs += held;
+        if (held > s.maxHoldUs) {
+            s.maxHoldUs = held;
+        }
+    }
+    
+    owner = I2C_DEVICE_COUNT;
+    xSemaphoreGive(mutex);
+}
+
+void I2CBus::printStats() const {
+    static const char* const names[I2C_DEVICE_COUNT] = {"OLED", "RTC"};
+    
+    for (uint8_t i = 0; i < I2C_DEVICE_COUNT; i++) {
+        DEBUG_PRINTF("I2C %-4s: %lu txn, %lu us busy, max hold %lu us, max wait %lu us\n",
+                     names[i], stats[i].transactions, stats[i].busTimeUs,
+                     stats[i].maxHoldUs, stats[i].maxWaitUs);
+    }
+}
+
+I2CBusGuard::I2CBusGuard(I2CDevice device, I2CPriority priority) {
+    i2cBus.acquire(device, priority);
+}
+
+I2CBusGuard::~I2CBusGuard() {
+    i2cBus.release();
+}
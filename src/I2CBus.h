@@ -0,0 +1,118 @@
+/**
+ * @file I2CBus.h
+ * @brief Shared I2C bus scheduler for the OLED and the DS3231 RTC
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "config.h"
+
+/**
+ * @brief Devices sharing the bus (used for per-device accounting)
+ */
+enum I2CDevice {
+    I2C_DEVICE_OLED = 0,
+    I2C_DEVICE_RTC,
+    I2C_DEVICE_COUNT
+};
+
+/**
+ * @brief Transaction priority
+ * 
+ * High-priority transactions (RTC reads) are served before any waiting
+ * low-priority one, and bulk low-priority transfers yield between chunks.
+ */
+enum I2CPriority {
+    I2C_PRIORITY_LOW = 0,
+    I2C_PRIORITY_HIGH
+};
+
+/**
+ * @brief Bus usage statistics for one device
+ */
+struct I2CDeviceStats {
+    uint32_t transactions;  // Completed bus grants
+    uint32_t busTimeUs;     // Total time holding the bus
+    uint32_t maxHoldUs;     // Longest single grant
+    uint32_t maxWaitUs;     // Longest wait for the bus
+};
+
+class I2CBus {
+public:
+    /**
+     * @brief Initialize the bus (owns Wire from here on)
+     * @param sda SDA pin
+     * @param scl SCL pin
+     * @param clock Bus clock in Hz
+     * @return true if the bus started
+     */
+    bool begin(uint8_t sda, uint8_t scl, uint32_t clock);
+    
+    /**
+     * @brief Wait for and take the bus
+     * @param device Device the transaction is for
+     * @param priority Transaction priority
+     */
+    void acquire(I2CDevice device, I2CPriority priority = I2C_PRIORITY_LOW);
+    
+    /**
+     * @brief Release the bus and account the time it was held
+     */
+    void release();
+    
+    /**
+     * @brief Check if a high-priority transaction is waiting
+     * @return true if the current holder should yield soon
+     */
+    bool hasPriorityWaiter() const { return priorityWaiters > 0; }
+    
+    /**
+     * @brief Get statistics for a device
+     * @param device Device to query
+     * @return Accumulated statistics
+     */
+    const I2CDeviceStats& getStats(I2CDevice device) const { return stats[device]; }
+    
+    /**
+     * @brief Print per-device bus usage to serial
+     */
+    void printStats() const;
+    
+    /**
+     * @brief Get the configured bus clock
+     * @return Clock in Hz
+     */
+    uint32_t getClock() const { return clock; }
+    
+    /**
+     * @brief Get the underlying Wire instance (only use while holding the bus)
+     * @return TwoWire reference
+     */
+    TwoWire& wire() { return Wire; }
+
+private:
+    SemaphoreHandle_t mutex;
+    volatile uint8_t priorityWaiters;
+    I2CDevice owner;
+    uint32_t acquiredAt;
+    uint32_t clock;
+    I2CDeviceStats stats[I2C_DEVICE_COUNT];
+};
+
+/**
+ * @brief Scoped bus grant (acquire in constructor, release in destructor)
+ */
+class I2CBusGuard {
+public:
+    I2CBusGuard(I2CDevice device, I2CPriority priority = I2C_PRIORITY_LOW);
+    ~I2CBusGuard();
+};
+
+extern I2CBus i2cBus;
+
+#endif // I2C_BUS_H
@@ -0,0 +1,82 @@
+/**
+ * @file LogStream.cpp
+ * @brief Streamed GET /api/logs reply implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "LogStream.h"
+#include "Storage.h"
+
+LogStream::LogStream(Storage* storage, uint32_t from, uint32_t to, uint32_t id,
+                     uint32_t limit, bool ranged)
+    : storage(storage), from(from), to(to), id(id), remaining(limit), ranged(ranged),
+      stage(STAGE_HEAD), firstRecord(true), batchCount(0), batchPos(0), more(true),
+      textLength(0), textPos(0) {}
+
+size_t LogStream::fill(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    
+    while (written < maxLen) {
+        if (textPos == textLength && !nextText()) break;
+        
+        size_t length = min((size_t)(textLength - textPos), maxLen - written);
+        memcpy(buffer + written, text + textPos, length);
+        textPos += length;
+        written += length;
+    }
+    
+    return written;
+}
+
+bool LogStream::nextText() {
+    EventLog& eventLog = storage->getEventLog();
+    int length = 0;
+    
+    switch (stage) {
+        case STAGE_HEAD:
+            length = snprintf(text, sizeof(text), "{\"totalOpenings\":%lu,\"first\":%lu,\"logs\":[",
+                              (unsigned long)eventLog.getCount(), (unsigned long)eventLog.getFirstId());
+            stage = STAGE_RECORDS;
+            break;
+        
+        case STAGE_RECORDS:
+            if (batchPos == batchCount && more && remaining > 0) {
+                uint8_t wanted = min(remaining, (uint32_t)WEB_LOG_BATCH);
+                batchCount = storage->getLogsInRange(from, to, id, batch, wanted);
+                batchPos = 0;
+                more = (batchCount == wanted);
+                remaining -= batchCount;
+            }
+            
+            if (batchPos < batchCount) {
+                const LogEntry& entry = batch[batchPos++];
+                length = snprintf(text, sizeof(text), "%s{\"time\":%lu", firstRecord ? "" : ",",
+                                  (unsigned long)entry.timestamp);
+                if (entry.doseIndex != HISTORY_NO_DOSE) {
+                    length += snprintf(text + length, sizeof(text) - length, ",\"dose\":%u",
+                                       entry.doseIndex);
+                }
+                length += snprintf(text + length, sizeof(text) - length, ",\"onTime\":%s}",
+                                   entry.wasOnTime ? "true" : "false");
+                firstRecord = false;
+                break;
+            }
+            
+            // Ranged reads omit "next" once the range is exhausted
+            if (!ranged || remaining == 0) {
+                length = snprintf(text, sizeof(text), "],\"next\":%lu}", (unsigned long)id);
+            } else {
+                length = snprintf(text, sizeof(text), "]}");
+            }
+            stage = STAGE_DONE;
+            break;
+        
+        case STAGE_DONE:
+            return false;
+    }
+    
+    textLength = length;
+    textPos = 0;
+    return true;
+}
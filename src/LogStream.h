@@ -0,0 +1,75 @@
+/**
+ * @file LogStream.h
+ * @brief GET /api/logs reply, formatted a chunk at a time
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef LOG_STREAM_H
+#define LOG_STREAM_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "HistoryCodec.h"
+
+class Storage;
+
+/**
+ * @brief One GET /api/logs reply, produced a chunk at a time
+ *
+ * Records are read WEB_LOG_BATCH at a time and formatted one at a time
+ * into the response buffer, so memory use does not grow with the number
+ * of records sent. Runs on the web server task (the event log is
+ * thread-safe).
+ */
+class LogStream {
+public:
+    /**
+     * @param storage Storage holding the event log
+     * @param from First Unix time wanted (inclusive)
+     * @param to Last Unix time wanted (inclusive)
+     * @param id Record id to start at
+     * @param limit Most records to send
+     * @param ranged from or to was given: "next" is left out once the
+     *               range is exhausted
+     */
+    LogStream(Storage* storage, uint32_t from, uint32_t to, uint32_t id,
+              uint32_t limit, bool ranged);
+    
+    /**
+     * @brief Fill the next chunk of the reply
+     * @param buffer Output buffer
+     * @param maxLen Buffer size
+     * @return Bytes written (0 once the reply is complete)
+     */
+    size_t fill(uint8_t* buffer, size_t maxLen);
+
+private:
+    enum Stage { STAGE_HEAD, STAGE_RECORDS, STAGE_DONE };
+    
+    Storage* storage;
+    uint32_t from;
+    uint32_t to;
+    uint32_t id;                // Next record id to read
+    uint32_t remaining;         // Records still allowed by ?limit
+    bool ranged;
+    Stage stage;
+    bool firstRecord;
+    
+    LogEntry batch[WEB_LOG_BATCH];
+    uint8_t batchCount;
+    uint8_t batchPos;
+    bool more;                  // The log may hold more records to send
+    
+    char text[64];              // Formatted piece not yet copied out
+    uint8_t textLength;
+    uint8_t textPos;
+    
+    /**
+     * @brief Format the next piece of the reply into text
+     * @return false once the reply is complete
+     */
+    bool nextText();
+};
+
+#endif // LOG_STREAM_H
@@ -10,27 +10,56 @@
 #include "DoseManager.h"
 #include "AlarmController.h"
 #include "Storage.h"
+#include "UIManager.h"
+#include "I2CBus.h"
+#include "LidSensor.h"
+#include "LogStream.h"
 
-PillBoxWebServer::PillBoxWebServer() : server(WEB_SERVER_PORT) {
+PillBoxWebServer::PillBoxWebServer() : server(WEB_SERVER_PORT), events("/api/events") {
     timeManager = nullptr;
     doseManager = nullptr;
     alarmController = nullptr;
     storage = nullptr;
+    uiManager = nullptr;
+    lidSensor = nullptr;
     running = false;
     timeEditUnlocked = false;
     timeUnlockCallback = nullptr;
+    lastEventCheck = 0;
+    pushedMinute = 0xFFFF;      // Not a minute: the first check sends the time
+    pushedGeneration = 0;
+    pushedAlarmActive = false;
+    pushedSnoozed = false;
+    pushedAlarmEnabled = false;
+    pushedLidOpen = false;
+    bootTag = 0;
+    statusGeneration = 0;
+    seenDoseGeneration = 0;
+    seenAlarmGeneration = 0;
+    seenClock = 0;
+    seenUnlocked = false;
+    statusBodyGeneration = 0;
+    dosesBodyGeneration = 0;
 }
 
 void PillBoxWebServer::begin(TimeManager* tm, DoseManager* dm, 
-                              AlarmController* ac, Storage* st) {
+                              AlarmController* ac, Storage* st, UIManager* ui,
+                              LidSensor* lid) {
     timeManager = tm;
     doseManager = dm;
     alarmController = ac;
     storage = st;
+    uiManager = ui;
+    lidSensor = lid;
+    
+    // Generations restart at 0 on every boot
+    bootTag = esp_random();
     
     // Initialize SPIFFS for serving HTML files
     if (!SPIFFS.begin(true)) {
         DEBUG_PRINTLN("ERROR: SPIFFS mount failed");
+    } else {
+        webAssets.begin();
     }
     
     DEBUG_PRINTLN("PillBoxWebServer initialized");
@@ -65,6 +94,7 @@ void PillBoxWebServer::stop() {
         return;
     }
     
+    events.close();
     server.end();
     WiFi.softAPdisconnect(true);
     WiFi.mode(WIFI_OFF);
@@ -75,6 +105,63 @@ void PillBoxWebServer::stop() {
     DEBUG_PRINTLN("Web server stopped");
 }
 
+void PillBoxWebServer::update() {
+    if (!running || events.count() == 0) return;
+    if (millis() - lastEventCheck < WEB_EVENT_INTERVAL) return;
+    lastEventCheck = millis();
+    
+    char json[128];
+    
+    // Lid first: it is the change the page should show soonest
+    bool lidOpen = lidSensor && lidSensor->isOpen();
+    if (lidOpen != pushedLidOpen) {
+        pushedLidOpen = lidOpen;
+        snprintf(json, sizeof(json), "{\"open\":%s}", lidOpen ? "true" : "false");
+        events.send(json, "lid");
+    }
+    
+    bool alarmActive = alarmController->isActive();
+    bool snoozed = alarmController->isSnoozed();
+    bool alarmEnabled = alarmController->isEnabled();
+    if (alarmActive != pushedAlarmActive || snoozed != pushedSnoozed ||
+        alarmEnabled != pushedAlarmEnabled) {
+        pushedAlarmActive = alarmActive;
+        pushedSnoozed = snoozed;
+        pushedAlarmEnabled = alarmEnabled;
+        snprintf(json, sizeof(json), "{\"active\":%s,\"snoozed\":%s,\"enabled\":%s}",
+                 alarmActive ? "true" : "false", snoozed ? "true" : "false",
+                 alarmEnabled ? "true" : "false");
+        events.send(json, "alarm");
+    }
+    
+    MinuteOfDay minute = timeManager->getMinuteOfDay();
+    uint32_t generation = doseManager->getGeneration();
+    
+    // The countdown moves with both, so both events carry it
+    if (generation != pushedGeneration) {
+        pushedGeneration = generation;
+        snprintf(json, sizeof(json),
+                 "{\"generation\":%lu,\"doseCount\":%u,\"dosesTaken\":%u,\"minutesToNextDose\":%d}",
+                 (unsigned long)generation, doseManager->getDoseCount(),
+                 doseManager->getDosesTakenCount(), doseManager->getMinutesUntilNextDose(minute));
+        events.send(json, "doses");
+    }
+    
+    if (minute != pushedMinute) {
+        pushedMinute = minute;
+        Time12H time = toTime12H(minute);
+        uint8_t day, month;
+        uint16_t year;
+        timeManager->getDate(day, month, year);
+        snprintf(json, sizeof(json),
+                 "{\"hour\":%u,\"minute\":%u,\"isPM\":%s,\"day\":%u,\"month\":%u,\"year\":%u,"
+                 "\"minutesToNextDose\":%d}",
+                 time.hour, time.minute, time.isPM ? "true" : "false", day, month, year,
+                 doseManager->getMinutesUntilNextDose(minute));
+        events.send(json, "time");
+    }
+}
+
 String PillBoxWebServer::getIPAddress() const {
     if (running) {
         return WiFi.softAPIP().toString();
@@ -94,14 +181,20 @@ void PillBoxWebServer::setTimeUnlockCallback(void (*callback)(bool)) {
 }
 
 void PillBoxWebServer::setupRoutes() {
-    // Serve index.html
+    // Pre-gzipped web UI files, with ETag revalidation
+    server.addHandler(&webAssets);
+    
+    // Serve index.html (when there is no asset manifest)
     server.on("/", HTTP_GET, [](AsyncWebServerRequest* request) {
         request->send(SPIFFS, "/index.html", "text/html");
     });
     
-    // Serve static files
+    // Serve static files not in the manifest
     server.serveStatic("/", SPIFFS, "/");
     
+    // GET /api/events: state changes pushed as server-sent events
+    server.addHandler(&events);
+    
     // Handle CORS preflight
     server.on("/*", HTTP_OPTIONS, [this](AsyncWebServerRequest* request) {
         AsyncWebServerResponse* response = request->beginResponse(200);
@@ -137,12 +230,15 @@ void PillBoxWebServer::setupRoutes() {
         }
     );
     
-    // POST /api/doses
+    // POST /api/doses (bulk replace, body may span several chunks)
     server.on("/api/doses", HTTP_POST,
         [](AsyncWebServerRequest* request) {},
         NULL,
         [this](AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
-            handleSetDoses(request, data, len);
+            uint8_t* body = collectBody(request, data, len, index, total);
+            if (body) {
+                handleSetDoses(request, body, total);
+            }
         }
     );
     
@@ -183,6 +279,11 @@ void PillBoxWebServer::setupRoutes() {
         handleGetLogs(request);
     });
     
+    // GET /api/stats
+    server.on("/api/stats", HTTP_GET, [this](AsyncWebServerRequest* request) {
+        handleGetStats(request);
+    });
+    
     // 404 handler
     server.onNotFound([this](AsyncWebServerRequest* request) {
         sendError(request, 404, "Not Found");
@@ -190,6 +291,21 @@ void PillBoxWebServer::setupRoutes() {
 }
 
 void PillBoxWebServer::handleGetStatus(AsyncWebServerRequest* request) {
+    uint32_t generation = getStatusGeneration();
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)bootTag,
+             (unsigned long)generation);
+    
+    if (sendNotModified(request, etag)) {
+        return;
+    }
+    
+    // Most polls find nothing changed: resend the last body as is
+    if (statusBody.length() > 0 && statusBodyGeneration == generation) {
+        sendCachedJson(request, statusBody, etag);
+        return;
+    }
+    
     StaticJsonDocument<512> doc;
     
     // Current time
@@ -210,9 +326,11 @@ void PillBoxWebServer::handleGetStatus(AsyncWebServerRequest* request) {
     doc["doseCount"] = doseManager->getDoseCount();
     doc["dosesTaken"] = doseManager->getDosesTakenCount();
     
-    // Next dose
-    int16_t minutesToNext = doseManager->getMinutesUntilNextDose(*timeManager);
-    doc["minutesToNextDose"] = minutesToNext;
+    // Next dose, searched here: the cached cursor belongs to the main loop
+    MinuteOfDay minute = timeManager->getMinuteOfDay();
+    int16_t nextIndex = doseManager->findNextDose(minute);
+    doc["minutesToNextDose"] = nextIndex < 0 ? -1 :
+                               (int16_t)minutesForward(minute, doseManager->getDoseTime(nextIndex));
     
     // Alarm status
     doc["alarmEnabled"] = alarmController->isEnabled();
@@ -222,31 +340,52 @@ void PillBoxWebServer::handleGetStatus(AsyncWebServerRequest* request) {
     // Time edit unlock status
     doc["timeEditUnlocked"] = timeEditUnlocked;
     
-    String response;
-    serializeJson(doc, response);
-    sendJsonResponse(request, 200, response);
+    statusBody = "";
+    serializeJson(doc, statusBody);
+    statusBodyGeneration = generation;
+    sendCachedJson(request, statusBody, etag);
 }
 
 void PillBoxWebServer::handleGetDoses(AsyncWebServerRequest* request) {
-    StaticJsonDocument<1024> doc;
+    // Read before the table: a change made while serializing then only
+    // leaves the body newer than its generation, never older
+    uint32_t generation = doseManager->getGeneration();
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)bootTag,
+             (unsigned long)generation);
+    
+    if (sendNotModified(request, etag)) {
+        return;
+    }
+    
+    if (dosesBody.length() > 0 && dosesBodyGeneration == generation) {
+        sendCachedJson(request, dosesBody, etag);
+        return;
+    }
+    
+    const DoseTable& table = doseManager->getTable();
+    
+    // Sized for the schedule: up to MAX_DOSES entries of 7 fields
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(table.count) +
+                            table.count * JSON_OBJECT_SIZE(7));
     JsonArray doses = doc.createNestedArray("doses");
     
-    for (uint8_t i = 0; i < doseManager->getDoseCount(); i++) {
-        Dose* dose = doseManager->getDose(i);
-        if (dose) {
-            JsonObject doseObj = doses.createNestedObject();
-            doseObj["id"] = i;
-            doseObj["hour"] = dose->time.hour;
-            doseObj["minute"] = dose->time.minute;
-            doseObj["isPM"] = dose->time.isPM;
-            doseObj["enabled"] = dose->enabled;
-            doseObj["taken"] = dose->taken;
-        }
+    for (uint16_t i = 0; i < table.count; i++) {
+        JsonObject doseObj = doses.createNestedObject();
+        doseObj["id"] = i;
+        Time12H time = toTime12H(table.minutes[i]);
+        doseObj["hour"] = time.hour;
+        doseObj["minute"] = time.minute;
+        doseObj["isPM"] = time.isPM;
+        doseObj["compartment"] = table.compartments[i];
+        doseObj["enabled"] = (table.flags[i] & DOSE_FLAG_ENABLED) != 0;
+        doseObj["taken"] = (table.flags[i] & DOSE_FLAG_TAKEN) != 0;
     }
     
-    String response;
-    serializeJson(doc, response);
-    sendJsonResponse(request, 200, response);
+    dosesBody = "";
+    serializeJson(doc, dosesBody);
+    dosesBodyGeneration = generation;
+    sendCachedJson(request, dosesBody, etag);
 }
 
 void PillBoxWebServer::handleSetTime(AsyncWebServerRequest* request, uint8_t* data, size_t len) {
@@ -317,9 +456,24 @@ void PillBoxWebServer::handleSetDate(AsyncWebServerRequest* request, uint8_t* da
 }
 
 void PillBoxWebServer::handleSetDoses(AsyncWebServerRequest* request, uint8_t* data, size_t len) {
-    StaticJsonDocument<1024> doc;
+    // Sized from the body: every JSON value takes at least two bytes of it
+    // and one slot in the pool, plus at most len bytes of copied strings.
+    // Capped at what a full schedule needs.
+    const size_t fullSchedule = JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(MAX_DOSES) +
+                                MAX_DOSES * JSON_OBJECT_SIZE(6);
+    DynamicJsonDocument doc(min(JSON_OBJECT_SIZE(1) + (len / 2) * JSON_ARRAY_SIZE(1) + len,
+                                fullSchedule));
+    if (doc.capacity() == 0) {
+        sendError(request, 500, "Out of memory");
+        return;
+    }
+    
     DeserializationError error = deserializeJson(doc, data, len);
     
+    if (error == DeserializationError::NoMemory) {
+        sendError(request, 413, "Too many doses");
+        return;
+    }
     if (error) {
         sendError(request, 400, "Invalid JSON");
         return;
@@ -330,27 +484,115 @@ void PillBoxWebServer::handleSetDoses(AsyncWebServerRequest* request, uint8_t* d
         return;
     }
     
-    // Clear existing doses
-    doseManager->clearAllDoses();
-    
     JsonArray doses = doc["doses"].as<JsonArray>();
+    if (doses.size() > MAX_DOSES) {
+        sendError(request, 400, "Too many doses");
+        return;
+    }
+    
+    // Stage every item so all errors are reported, not just the first
+    static DoseBatchError itemErrors[MAX_DOSES];
+    memset(itemErrors, 0, sizeof(itemErrors));
+    
+    doseManager->beginReplace();
+    
+    uint16_t itemCount = 0;
+    uint16_t invalid = 0;
     for (JsonObject doseObj : doses) {
-        Time12H time;
-        time.hour = doseObj["hour"];
-        time.minute = doseObj["minute"];
-        time.isPM = doseObj["isPM"];
+        int hour = doseObj["hour"] | 0;
+        int minute = doseObj["minute"] | -1;
+        int compartment = doseObj["compartment"] | 0;
         
-        if (TimeManager::isValidTime(time)) {
-            doseManager->addDose(time);
+        DoseBatchError itemError;
+        if (hour < 1 || hour > 12 || minute < 0 || minute > 59) {
+            itemError = DOSE_BATCH_INVALID_TIME;
+        } else if (compartment < 0 || compartment >= MAX_COMPARTMENTS) {
+            itemError = DOSE_BATCH_INVALID_COMPARTMENT;
+        } else {
+            Time12H time(hour, minute, doseObj["isPM"] | false);
+            itemError = doseManager->stageDose(itemCount, toMinuteOfDay(time),
+                                               compartment, doseObj["enabled"] | true);
         }
+        
+        if (itemError != DOSE_BATCH_OK) {
+            itemErrors[itemCount] = itemError;
+            invalid++;
+        }
+        itemCount++;
     }
     
-    // Save to storage
-    if (storage) {
-        doseManager->saveToStorage(*storage);
+    // Spacing is only checked once every item is valid; the active
+    // schedule is left untouched unless the whole batch is accepted
+    uint16_t conflicts = 0;
+    if (invalid == 0) {
+        conflicts = doseManager->commitReplace(itemErrors);
+    } else {
+        doseManager->beginReplace();
     }
     
-    sendJsonResponse(request, 200, "{\"success\":true}");
+    if (invalid > 0 || conflicts > 0) {
+        uint16_t errorCount = 0;
+        for (uint16_t i = 0; i < itemCount; i++) {
+            if (itemErrors[i] != DOSE_BATCH_OK) errorCount++;
+        }
+        
+        DynamicJsonDocument result(JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(errorCount) +
+                                   errorCount * JSON_OBJECT_SIZE(2));
+        result["success"] = false;
+        result["error"] = "Schedule rejected";
+        JsonArray errors = result.createNestedArray("errors");
+        for (uint16_t i = 0; i < itemCount; i++) {
+            if (itemErrors[i] == DOSE_BATCH_OK) continue;
+            JsonObject item = errors.createNestedObject();
+            item["index"] = i;
+            item["error"] = DoseManager::getBatchErrorName(itemErrors[i]);
+        }
+        
+        String response;
+        serializeJson(result, response);
+        sendJsonResponse(request, 400, response);
+        return;
+    }
+    
+    // Not saved here: the main loop writes it (DoseManager::update), so
+    // NVS is only touched from one task
+    StaticJsonDocument<64> result;
+    result["success"] = true;
+    result["count"] = doseManager->getDoseCount();
+    
+    String response;
+    serializeJson(result, response);
+    sendJsonResponse(request, 200, response);
+}
+
+uint8_t* PillBoxWebServer::collectBody(AsyncWebServerRequest* request, uint8_t* data,
+                                       size_t len, size_t index, size_t total) {
+    // Single chunk: use it in place
+    if (index == 0 && len == total) {
+        return data;
+    }
+    
+    if (index == 0) {
+        if (total > WEB_MAX_BODY_SIZE) {
+            sendError(request, 413, "Request body too large");
+            return nullptr;
+        }
+        request->_tempObject = malloc(total);
+        if (!request->_tempObject) {
+            sendError(request, 500, "Out of memory");
+            return nullptr;
+        }
+    }
+    
+    // Oversized or failed body: later chunks are dropped
+    if (!request->_tempObject) {
+        return nullptr;
+    }
+    
+    uint8_t* body = (uint8_t*)request->_tempObject;
+    memcpy(body + index, data, len);
+    
+    return (index + len == total) ? body : nullptr;
 }
 
 void PillBoxWebServer::handleAddDose(AsyncWebServerRequest* request, uint8_t* data, size_t len) {
@@ -377,16 +619,13 @@ void PillBoxWebServer::handleAddDose(AsyncWebServerRequest* request, uint8_t* da
         return;
     }
     
-    if (!doseManager->addDose(time)) {
+    uint8_t compartment = doc["compartment"] | 0;
+    
+    if (!doseManager->addDose(toMinuteOfDay(time), compartment)) {
         sendError(request, 400, "Cannot add dose (max reached or time conflict)");
         return;
     }
     
-    // Save to storage
-    if (storage) {
-        doseManager->saveToStorage(*storage);
-    }
-    
     sendJsonResponse(request, 200, "{\"success\":true}");
 }
 
@@ -396,18 +635,13 @@ void PillBoxWebServer::handleDeleteDose(AsyncWebServerRequest* request) {
         return;
     }
     
-    uint8_t id = request->getParam("id")->value().toInt();
+    uint16_t id = request->getParam("id")->value().toInt();
     
     if (!doseManager->removeDose(id)) {
         sendError(request, 400, "Invalid dose id");
         return;
     }
     
-    // Save to storage
-    if (storage) {
-        doseManager->saveToStorage(*storage);
-    }
-    
     sendJsonResponse(request, 200, "{\"success\":true}");
 }
 
@@ -457,18 +691,156 @@ void PillBoxWebServer::handleUnlockTime(AsyncWebServerRequest* request, uint8_t*
 }
 
 void PillBoxWebServer::handleGetLogs(AsyncWebServerRequest* request) {
-    // TODO: Implement log retrieval from storage
-    StaticJsonDocument<256> doc;
-    JsonArray logs = doc.createNestedArray("logs");
+    if (!storage) {
+        sendError(request, 503, "Storage unavailable");
+        return;
+    }
+    
+    // Streamed, so any page size costs the same memory
+    uint32_t limit = WEB_LOG_PAGE;
+    if (request->hasParam("limit")) {
+        limit = max(strtoul(request->getParam("limit")->value().c_str(), nullptr, 10), 1UL);
+    }
+    
+    bool ranged = request->hasParam("from") || request->hasParam("to");
+    uint32_t from = 0;
+    uint32_t to = UINT32_MAX;
+    if (request->hasParam("from")) {
+        from = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+    }
+    if (request->hasParam("to")) {
+        to = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+    }
+    
+    // Resume at a cursor ("next" of the previous page), else start at the
+    // range or at the newest page
+    uint32_t id = 0;
+    const char* cursor = request->hasParam("since") ? "since" : "start";
+    if (request->hasParam(cursor)) {
+        id = strtoul(request->getParam(cursor)->value().c_str(), nullptr, 10);
+    } else if (!ranged) {
+        uint32_t end = storage->getEventLog().getEndId();
+        id = (end > limit) ? end - limit : 0;
+    }
+    
+    LogStream stream(storage, from, to, id, limit, ranged);
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t* buffer, size_t maxLen, size_t) mutable -> size_t {
+            return stream.fill(buffer, maxLen);
+        });
+    addCorsHeaders(response);
+    request->send(response);
+}
+
+void PillBoxWebServer::handleGetStats(AsyncWebServerRequest* request) {
+    DynamicJsonDocument doc(4096);
+    
+    if (uiManager) {
+        JsonObject frames = doc.createNestedObject("frames");
+        
+        for (uint8_t i = 1; i < SCREEN_COUNT; i++) {
+            const ScreenFrameStats& stats = uiManager->getFrameStats((ScreenId)i);
+            if (stats.render.count == 0 && stats.deferred == 0) continue;
+            
+            JsonObject screen = frames.createNestedObject(UIManager::getScreenName((ScreenId)i));
+            screen["count"] = stats.render.count;
+            screen["deferred"] = stats.deferred;
+            
+            JsonObject render = screen.createNestedObject("renderUs");
+            render["min"] = stats.render.minUs;
+            render["avg"] = stats.render.averageUs();
+            render["p99"] = stats.render.percentileUs(99);
+            
+            JsonObject flush = screen.createNestedObject("flushUs");
+            flush["min"] = stats.flush.minUs;
+            flush["avg"] = stats.flush.averageUs();
+            flush["p99"] = stats.flush.percentileUs(99);
+        }
+        
+        doc["oledBytesPerSecond"] = uiManager->getBytesPerSecond();
+    }
     
-    // Placeholder - would be populated from storage
-    doc["totalOpenings"] = 0;
+    JsonObject i2c = doc.createNestedObject("i2c");
+    static const char* const deviceNames[I2C_DEVICE_COUNT] = {"oled", "rtc"};
+    for (uint8_t i = 0; i < I2C_DEVICE_COUNT; i++) {
+        const I2CDeviceStats& stats = i2cBus.getStats((I2CDevice)i);
+        JsonObject device = i2c.createNestedObject(deviceNames[i]);
+        device["transactions"] = stats.transactions;
+        device["busTimeUs"] = stats.busTimeUs;
+        device["maxHoldUs"] = stats.maxHoldUs;
+        device["maxWaitUs"] = stats.maxWaitUs;
+    }
+    
+    if (storage) {
+        const SettingsWriteStats& writes = storage->getSettingsWriteStats();
+        JsonObject settings = doc.createNestedObject("settingsWrites");
+        settings["requested"] = writes.requested;
+        settings["performed"] = writes.performed;
+        settings["flashTimeUs"] = writes.flashTimeUs;
+        settings["maxWriteUs"] = writes.maxWriteUs;
+        
+        const NvsStats& nvs = storage->getNvsStats();
+        JsonObject ops = doc.createNestedObject("nvs");
+        ops["reads"] = nvs.reads;
+        ops["writes"] = nvs.writes;
+        
+        JsonObject integrity = doc.createNestedObject("integrity");
+        integrity["skippedDoses"] = storage->getSkippedDoses();
+        integrity["damagedLogBlocks"] = storage->getEventLog().getDamagedBlocks();
+    }
     
     String response;
     serializeJson(doc, response);
     sendJsonResponse(request, 200, response);
 }
 
+uint32_t PillBoxWebServer::getStatusGeneration() {
+    uint8_t day, month;
+    uint16_t year;
+    timeManager->getDate(day, month, year);
+    uint32_t clock = ((uint32_t)year << 20) | ((uint32_t)month << 16) |
+                     ((uint32_t)day << 11) | timeManager->getMinuteOfDay();
+    uint32_t doseGeneration = doseManager->getGeneration();
+    uint32_t alarmGeneration = alarmController->getGeneration();
+    
+    // Polled rather than notified, so the counter only moves when a
+    // request is made, and by one however much changed in between
+    if (clock != seenClock || doseGeneration != seenDoseGeneration ||
+        alarmGeneration != seenAlarmGeneration || timeEditUnlocked != seenUnlocked) {
+        seenClock = clock;
+        seenDoseGeneration = doseGeneration;
+        seenAlarmGeneration = alarmGeneration;
+        seenUnlocked = timeEditUnlocked;
+        statusGeneration++;
+    }
+    
+    return statusGeneration;
+}
+
+bool PillBoxWebServer::sendNotModified(AsyncWebServerRequest* request, const char* etag) {
+    // server.on() handlers keep all request headers, so If-None-Match is there
+    if (!request->hasHeader("If-None-Match") ||
+        request->getHeader("If-None-Match")->value() != etag) {
+        return false;
+    }
+    
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", WEB_CACHE_CONTROL);
+    addCorsHeaders(response);
+    request->send(response);
+    return true;
+}
+
+void PillBoxWebServer::sendCachedJson(AsyncWebServerRequest* request, const String& json,
+                                      const char* etag) {
+    AsyncWebServerResponse* response = request->beginResponse(200, "application/json", json);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", WEB_CACHE_CONTROL);
+    addCorsHeaders(response);
+    request->send(response);
+}
+
 void PillBoxWebServer::addCorsHeaders(AsyncWebServerResponse* response) {
     response->addHeader("Access-Control-Allow-Origin", "*");
     response->addHeader("Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
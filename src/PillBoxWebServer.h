@@ -15,12 +15,15 @@
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
 #include "config.h"
+#include "WebAssets.h"
 
 // Forward declarations
 class TimeManager;
 class DoseManager;
 class AlarmController;
 class Storage;
+class UIManager;
+class LidSensor;
 
 class PillBoxWebServer {
 public:
@@ -35,9 +38,12 @@ public:
      * @param doseManager Reference to DoseManager
      * @param alarmController Reference to AlarmController
      * @param storage Reference to Storage
+     * @param uiManager Reference to UIManager (for frame statistics)
+     * @param lidSensor Reference to LidSensor (for lid events)
      */
     void begin(TimeManager* timeManager, DoseManager* doseManager, 
-               AlarmController* alarmController, Storage* storage);
+               AlarmController* alarmController, Storage* storage,
+               UIManager* uiManager = nullptr, LidSensor* lidSensor = nullptr);
     
     /**
      * @brief Start WiFi Access Point and web server
@@ -56,6 +62,14 @@ public:
      */
     bool isRunning() const { return running; }
     
+    /**
+     * @brief Push state changes to /api/events subscribers (call every loop)
+     * @note Events are only sent when their state changed: "time" (minute
+     *       tick), "doses" (schedule or taken flags), "alarm" (start, stop,
+     *       snooze, enable) and "lid" (open, close)
+     */
+    void update();
+    
     /**
      * @brief Get IP address of the access point
      * @return IP address as string
@@ -76,14 +90,40 @@ public:
 
 private:
     AsyncWebServer server;
+    AsyncEventSource events;
+    WebAssets webAssets;
     TimeManager* timeManager;
     DoseManager* doseManager;
     AlarmController* alarmController;
     Storage* storage;
+    UIManager* uiManager;
+    LidSensor* lidSensor;
     bool running;
     bool timeEditUnlocked;
     void (*timeUnlockCallback)(bool);
     
+    // State last pushed to /api/events, compared in update()
+    uint32_t lastEventCheck;
+    MinuteOfDay pushedMinute;
+    uint32_t pushedGeneration;
+    bool pushedAlarmActive;
+    bool pushedSnoozed;
+    bool pushedAlarmEnabled;
+    bool pushedLidOpen;
+    
+    // Conditional GET for /api/status and /api/doses. Only touched from the
+    // web server task, so update() never races the cached bodies.
+    uint32_t bootTag;               // Keeps ETags from before a restart from matching
+    uint32_t statusGeneration;      // Bumped when anything /api/status shows changes
+    uint32_t seenDoseGeneration;
+    uint32_t seenAlarmGeneration;
+    uint32_t seenClock;             // Date and minute of day, packed
+    bool seenUnlocked;
+    String statusBody;              // Last serialized reply (empty until built)
+    uint32_t statusBodyGeneration;
+    String dosesBody;
+    uint32_t dosesBodyGeneration;
+    
     /**
      * @brief Setup API routes
      */
@@ -91,6 +131,7 @@ private:
     
     /**
      * @brief Handle GET /api/status
+     * @note Conditional: If-None-Match with the current ETag gets a 304
      */
     void handleGetStatus(AsyncWebServerRequest* request);
     
@@ -106,14 +147,23 @@ private:
     
     /**
      * @brief Handle GET /api/doses
+     * @note Conditional: If-None-Match with the current ETag gets a 304
      */
     void handleGetDoses(AsyncWebServerRequest* request);
     
     /**
-     * @brief Handle POST /api/doses
+     * @brief Handle POST /api/doses (replace the whole schedule or nothing)
      */
     void handleSetDoses(AsyncWebServerRequest* request, uint8_t* data, size_t len);
     
+    /**
+     * @brief Reassemble a POST body that arrives in several chunks
+     * @return Complete body once the last chunk is in, else nullptr
+     * @note The buffer is owned by the request and freed with it
+     */
+    uint8_t* collectBody(AsyncWebServerRequest* request, uint8_t* data,
+                         size_t len, size_t index, size_t total);
+    
     /**
      * @brief Handle POST /api/dose
      */
@@ -136,9 +186,41 @@ private:
     
     /**
      * @brief Handle GET /api/logs
+     * @note Optional ?from=&to= (Unix times, inclusive), ?since=<record id>
+     *       (or ?start=) and ?limit=<n>; defaults to the latest WEB_LOG_PAGE
+     *       entries. Pass "next" from the reply as ?since= to continue.
+     *       The reply is streamed in chunks, so ?limit has no upper bound.
      */
     void handleGetLogs(AsyncWebServerRequest* request);
     
+    /**
+     * @brief Handle GET /api/stats
+     */
+    void handleGetStats(AsyncWebServerRequest* request);
+    
+    /**
+     * @brief Get the /api/status generation, bumping it if its inputs changed
+     * @return Counter that changes with the schedule, the alarm state, the
+     *         clock's minute or date, and the time edit lock
+     */
+    uint32_t getStatusGeneration();
+    
+    /**
+     * @brief Answer 304 if the client already has this generation
+     * @param request Incoming GET request
+     * @param etag Quoted ETag of the current reply
+     * @return true if the 304 was sent
+     */
+    bool sendNotModified(AsyncWebServerRequest* request, const char* etag);
+    
+    /**
+     * @brief Send a cached JSON reply with its ETag
+     * @param request Incoming GET request
+     * @param json Serialized reply
+     * @param etag Quoted ETag of the reply
+     */
+    void sendCachedJson(AsyncWebServerRequest* request, const String& json, const char* etag);
+    
     /**
      * @brief Add CORS headers to response
      */
@@ -0,0 +1,162 @@
+/**
+ * @file PowerManager.cpp
+ * @brief Deep sleep and wake handling implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "PowerManager.h"
+#include "TimeManager.h"
+#include "DoseManager.h"
+#include "UIManager.h"
+#include "WakeSchedule.h"
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
+
+#define SLEEP_STATE_MAGIC   0x50425A31  // "PBZ1"
+
+/**
+ * @brief State kept in RTC slow memory across deep sleep
+ * @note Plain data only: a constructor would re-run on every wake and
+ *       wipe the saved values
+ */
+struct SleepState {
+    uint32_t magic;
+    DoseTable doses;                    // Including taken flags
+    uint16_t statusDay;                 // Day the taken flags belong to
+    int16_t activeDoseIndex;
+    bool alarmActive;
+    bool snoozeActive;
+    uint32_t snoozeUntil;               // Unix timestamp
+    uint8_t currentDay;
+    bool lidArmed;                      // ext0 watches the lid, the timer the RTC wake
+};
+
+RTC_DATA_ATTR static SleepState sleepState;
+
+void PowerManager::begin() {
+    idle = false;
+    idleSince = 0;
+    
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    
+    if (sleepState.magic != SLEEP_STATE_MAGIC) {
+        wakeReason = WAKE_POWER_ON;
+    } else if (cause == ESP_SLEEP_WAKEUP_EXT0) {
+        wakeReason = sleepState.lidArmed ? WAKE_USER : WAKE_RTC_ALARM;
+    } else if (cause == ESP_SLEEP_WAKEUP_TIMER) {
+        wakeReason = WAKE_RTC_ALARM;
+    } else if (cause == ESP_SLEEP_WAKEUP_EXT1) {
+        wakeReason = WAKE_USER;
+    } else {
+        // Reset while a state was saved: it no longer applies
+        wakeReason = WAKE_POWER_ON;
+        sleepState.magic = 0;
+    }
+    
+    DEBUG_PRINTF("Wake reason: %d\n", wakeReason);
+}
+
+bool PowerManager::restoreState(DoseManager& doseManager, SystemState& state) {
+    if (!wokeFromSleep()) {
+        return false;
+    }
+    
+    doseManager.loadTable(sleepState.doses, sleepState.statusDay);
+    
+    state.activeDoseIndex = sleepState.activeDoseIndex;
+    state.alarmActive = sleepState.alarmActive;
+    state.snoozeActive = sleepState.snoozeActive;
+    state.snoozeUntil = sleepState.snoozeUntil;
+    state.currentDay = sleepState.currentDay;
+    
+    // Consumed: a later reset must not restore it again
+    sleepState.magic = 0;
+    
+    DEBUG_PRINTF("Restored %d doses from RTC memory\n", doseManager.getDoseCount());
+    return true;
+}
+
+void PowerManager::update(bool busy) {
+    if (busy) {
+        idle = false;
+        return;
+    }
+    
+    if (!idle) {
+        idle = true;
+        idleSince = millis();
+    }
+}
+
+bool PowerManager::shouldSleep() const {
+#if POWER_SLEEP_ENABLED
+    return idle && (millis() - idleSince >= SLEEP_IDLE_DELAY);
+#else
+    return false;
+#endif
+}
+
+void PowerManager::enterSleep(TimeManager& timeManager, DoseManager& doseManager,
+                              UIManager& uiManager, const SystemState& state) {
+    uint32_t now = timeManager.getUnixTime();
+    
+    // Save the schedule and alarm state to RTC memory
+    sleepState.doses = doseManager.getTable();
+    sleepState.statusDay = doseManager.getStatusDay();
+    sleepState.activeDoseIndex = state.activeDoseIndex;
+    sleepState.alarmActive = state.alarmActive;
+    sleepState.snoozeActive = state.snoozeActive;
+    sleepState.snoozeUntil = state.snoozeUntil;
+    sleepState.currentDay = state.currentDay;
+    
+    // A snoozed alarm must hear the lid as well as the OK button. ext1
+    // cannot mix polarities and ext0 normally has the RTC INT pin, so the
+    // lid (HIGH when open) takes ext0 and the ESP32 timer stands in for
+    // the RTC until the snooze ends (a few seconds of drift at most).
+    sleepState.lidArmed = state.alarmActive;
+    sleepState.magic = SLEEP_STATE_MAGIC;
+    
+    // Program the RTC; with nothing scheduled only a user wake applies
+    uint32_t wake = nextWakeTime(now, doseManager.getTable(), state);
+    if (wake != 0) {
+        timeManager.setWakeAlarm(wake);
+        if (sleepState.lidArmed) {
+            esp_sleep_enable_timer_wakeup((uint64_t)(wake - now) * 1000000ULL);
+        } else {
+            esp_sleep_enable_ext0_wakeup((gpio_num_t)RTC_INT_PIN, 0);
+        }
+    }
+    
+    // Otherwise only one user source can be armed on ext1: the OK button
+    // (Active LOW) or the lid
+    if (sleepState.lidArmed) {
+        esp_sleep_enable_ext0_wakeup((gpio_num_t)REED_SWITCH, 1);
+        esp_sleep_enable_ext1_wakeup(1ULL << BTN_OK, ESP_EXT1_WAKEUP_ALL_LOW);
+    } else {
+#if SLEEP_WAKE_ON_LID
+        esp_sleep_enable_ext1_wakeup(1ULL << REED_SWITCH, ESP_EXT1_WAKEUP_ANY_HIGH);
+#else
+        esp_sleep_enable_ext1_wakeup(1ULL << BTN_OK, ESP_EXT1_WAKEUP_ALL_LOW);
+#endif
+    }
+    
+    // Keep the wake pins pulled up while the digital GPIOs are off
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+    rtc_gpio_pullup_en((gpio_num_t)RTC_INT_PIN);
+    rtc_gpio_pulldown_dis((gpio_num_t)RTC_INT_PIN);
+    rtc_gpio_pullup_en((gpio_num_t)BTN_OK);
+    rtc_gpio_pulldown_dis((gpio_num_t)BTN_OK);
+    rtc_gpio_pullup_en((gpio_num_t)REED_SWITCH);
+    rtc_gpio_pulldown_dis((gpio_num_t)REED_SWITCH);
+    
+    uiManager.turnOff();
+    
+    DEBUG_PRINTF("Entering deep sleep, RTC wake at %lu (now %lu)\n",
+                 (unsigned long)wake, (unsigned long)now);
+#if DEBUG_ENABLED
+    Serial.flush();
+#endif
+    
+    esp_deep_sleep_start();
+}
@@ -0,0 +1,82 @@
+/**
+ * @file PowerManager.h
+ * @brief Deep sleep between dose events, woken by the DS3231 alarm
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Forward declarations
+class TimeManager;
+class DoseManager;
+class UIManager;
+
+// Why the ESP32 started
+enum WakeReason {
+    WAKE_POWER_ON = 0,      // Cold boot or reset
+    WAKE_RTC_ALARM,         // DS3231 Alarm1 (dose or midnight), or the timer ending a snooze
+    WAKE_USER               // Button press or lid opened
+};
+
+class PowerManager {
+public:
+    /**
+     * @brief Read the wake cause (call first in setup)
+     */
+    void begin();
+    
+    /**
+     * @brief Get the reason for this boot
+     * @return Wake reason
+     */
+    WakeReason getWakeReason() const { return wakeReason; }
+    
+    /**
+     * @brief Check if this boot is a wake from deep sleep
+     * @return true if woken from sleep with a valid saved state
+     */
+    bool wokeFromSleep() const { return wakeReason != WAKE_POWER_ON; }
+    
+    /**
+     * @brief Restore doses and alarm state saved before sleeping
+     * @param doseManager Dose manager to refill
+     * @param state System state to update
+     * @return true if a saved state was restored
+     */
+    bool restoreState(DoseManager& doseManager, SystemState& state);
+    
+    /**
+     * @brief Track idle time (call every loop)
+     * @param busy true while something needs the CPU awake
+     */
+    void update(bool busy);
+    
+    /**
+     * @brief Check if the device has been idle long enough to sleep
+     * @return true if sleep is due
+     */
+    bool shouldSleep() const;
+    
+    /**
+     * @brief Save state, program the RTC wake alarm and deep sleep
+     * @param timeManager Time manager (owns the RTC)
+     * @param doseManager Dose schedule to save
+     * @param uiManager Display to switch off
+     * @param state System state to save (snoozeUntil must be current)
+     * @note Does not return
+     */
+    void enterSleep(TimeManager& timeManager, DoseManager& doseManager,
+                    UIManager& uiManager, const SystemState& state);
+
+private:
+    WakeReason wakeReason;
+    uint32_t idleSince;
+    bool idle;
+};
+
+#endif // POWER_MANAGER_H
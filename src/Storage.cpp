@@ -7,17 +7,124 @@
 
 #include "Storage.h"
 #include "DoseManager.h"
+#include <rom/crc.h>
+
+// Dose record byte 2: bit 0 enabled, bit 1 taken, bits 4-7 compartment
+#define RECORD_FLAG_ENABLED     0x01
+#define RECORD_FLAG_TAKEN       0x02
+#define RECORD_COMPARTMENT_SHIFT 4
+
+// Dose blob: blocks of DOSE_BLOCK_RECORDS records, each followed by its
+// CRC-32 (little endian), so one bad block does not cost the whole schedule
+#define DOSE_CRC_SIZE           4
+#define DOSE_BLOCK_SIZE         (DOSE_BLOCK_RECORDS * DOSE_RECORD_SIZE + DOSE_CRC_SIZE)
+#define DOSE_BLOCKS(count)      (((count) + DOSE_BLOCK_RECORDS - 1) / DOSE_BLOCK_RECORDS)
+
+// Serialization buffer for the dose blob (too large for the loop stack)
+static uint8_t doseBuffer[MAX_DOSES * DOSE_RECORD_SIZE + DOSE_BLOCKS(MAX_DOSES) * DOSE_CRC_SIZE];
+
+// Largest schedule a v1 store could hold
+#define V1_MAX_DOSES            10
 
 // Storage keys
 static const char* KEY_VERSION = "version";
-static const char* KEY_DOSE_COUNT = "doseCount";
+static const char* KEY_DOSE_COUNT = "doseCount";  // v1/v2 only
 static const char* KEY_DOSES = "doses";
 static const char* KEY_ALARM_EN = "alarmEn";
 static const char* KEY_MUTE_MODE = "muteMode";
 static const char* KEY_LAST_DAY = "lastDay";
-static const char* KEY_LOG_COUNT = "logCount";
-static const char* KEY_LOGS = "logs";
-static const char* KEY_CRC = "crc";
+static const char* KEY_TAKEN_DAY = "takenDay";
+static const char* KEY_LOG_COUNT = "logCount";  // v3 and earlier
+static const char* KEY_CRC = "crc";            // v4 and earlier
+static const char* KEY_MIGRATION = "migration";    // Step version << 24 | progress
+static const char* KEY_MIGRATION_BASE = "migBase";
+static const char* KEY_STAGED_DOSES = "dosesNew";
+static const char* KEY_STAGED_LOG = "logNew";
+
+// One storage format upgrade (see Storage::migrateData)
+struct Migration {
+    uint8_t toVersion;
+    void (Storage::*upgrade)();
+};
+
+/**
+ * @brief Offset of a dose record in the blob
+ */
+static uint16_t doseOffset(uint16_t index) {
+    return (index / DOSE_BLOCK_RECORDS) * DOSE_BLOCK_SIZE + (index % DOSE_BLOCK_RECORDS) * DOSE_RECORD_SIZE;
+}
+
+/**
+ * @brief Number of dose records in a blob
+ * @param length Blob length
+ * @return Record count, or 0 if no record count gives that length
+ */
+static uint16_t doseCountForLength(size_t length) {
+    uint16_t rest = length % DOSE_BLOCK_SIZE;
+    uint16_t count = (length / DOSE_BLOCK_SIZE) * DOSE_BLOCK_RECORDS;
+    
+    if (rest != 0) {
+        if (rest <= DOSE_CRC_SIZE || (rest - DOSE_CRC_SIZE) % DOSE_RECORD_SIZE != 0) {
+            return 0;
+        }
+        count += (rest - DOSE_CRC_SIZE) / DOSE_RECORD_SIZE;
+    }
+    
+    return (count <= MAX_DOSES) ? count : 0;
+}
+
+/**
+ * @brief Spread records packed at the start of doseBuffer into CRC-32 blocks
+ * @param count Number of records
+ * @return Blob length
+ */
+static uint16_t packDoseBlocks(uint16_t count) {
+    // Back to front: each record moves up, past any not yet moved
+    for (int16_t i = count - 1; i >= 0; i--) {
+        memmove(&doseBuffer[doseOffset(i)], &doseBuffer[i * DOSE_RECORD_SIZE], DOSE_RECORD_SIZE);
+    }
+    
+    for (uint16_t first = 0; first < count; first += DOSE_BLOCK_RECORDS) {
+        uint16_t length = min((uint16_t)(count - first), (uint16_t)DOSE_BLOCK_RECORDS) * DOSE_RECORD_SIZE;
+        uint8_t* block = &doseBuffer[doseOffset(first)];
+        uint32_t crc = crc32_le(0, block, length);
+        memcpy(block + length, &crc, DOSE_CRC_SIZE);
+    }
+    
+    return count * DOSE_RECORD_SIZE + DOSE_BLOCKS(count) * DOSE_CRC_SIZE;
+}
+
+/**
+ * @brief Check each block of the blob in doseBuffer and pack the good records
+ * @param count Records in the blob
+ * @param skipped Output records dropped with a bad block
+ * @return Records now packed at the start of doseBuffer
+ */
+static uint16_t unpackDoseBlocks(uint16_t count, uint16_t& skipped) {
+    uint16_t valid = 0;
+    skipped = 0;
+    
+    for (uint16_t first = 0; first < count; first += DOSE_BLOCK_RECORDS) {
+        uint16_t records = min((uint16_t)(count - first), (uint16_t)DOSE_BLOCK_RECORDS);
+        uint16_t length = records * DOSE_RECORD_SIZE;
+        const uint8_t* block = &doseBuffer[doseOffset(first)];
+        uint32_t crc;
+        memcpy(&crc, block + length, DOSE_CRC_SIZE);
+        
+        if (crc32_le(0, block, length) != crc) {
+            DEBUG_PRINTF("ERROR: Dose block %d corrupted, %d doses skipped\n",
+                         first / DOSE_BLOCK_RECORDS, records);
+            skipped += records;
+            continue;
+        }
+        
+        // Front to back: records only move down
+        memmove(&doseBuffer[valid * DOSE_RECORD_SIZE], block, length);
+        valid += records;
+    }
+    
+    return valid;
+}
 
 bool Storage::begin() {
     initialized = prefs.begin(STORAGE_NAMESPACE, false);
@@ -27,223 +134,283 @@ bool Storage::begin() {
         return false;
     }
     
+    // Lid openings go to their own partition; the box still works without it
+    if (!eventLog.begin()) {
+        DEBUG_PRINTLN("WARNING: Event log unavailable, lid openings will not be logged");
+    }
+    
     // Check version and migrate if necessary
     uint8_t storedVersion = prefs.getUChar(KEY_VERSION, 0);
     
     if (storedVersion == 0) {
         // First run - initialize with defaults
         prefs.putUChar(KEY_VERSION, STORAGE_VERSION);
-        prefs.putUChar(KEY_DOSE_COUNT, 0);
         prefs.putBool(KEY_ALARM_EN, true);
         prefs.putBool(KEY_MUTE_MODE, false);
         prefs.putUChar(KEY_LAST_DAY, 0);
-        prefs.putUShort(KEY_LOG_COUNT, 0);
         DEBUG_PRINTLN("Storage initialized with defaults");
     } else if (storedVersion < STORAGE_VERSION) {
         migrateData(storedVersion);
     }
     
+    // Metadata and settings are served from RAM from here on. Any
+    // migration has finished, so the version needs no second read.
+    loadMeta();
+    meta.version = max(storedVersion, (uint8_t)STORAGE_VERSION);
+    alarmEnabled = meta.alarmEnabled;
+    muteMode = meta.muteMode;
+    settingsDirty = false;
+    memset(&settingsStats, 0, sizeof(settingsStats));
+    memset(&nvsStats, 0, sizeof(nvsStats));
+    skippedDoses = 0;
+    
     DEBUG_PRINTF("Storage initialized. Version: %d\n", STORAGE_VERSION);
     return true;
 }
 
-void Storage::saveDoses(Dose* doses, uint8_t count) {
+void Storage::loadMeta() {
+    meta.lastDay = prefs.getUChar(KEY_LAST_DAY, 0);
+    meta.takenDay = prefs.getUShort(KEY_TAKEN_DAY, 0);
+    meta.doseLength = prefs.getBytesLength(KEY_DOSES);
+    meta.alarmEnabled = prefs.getBool(KEY_ALARM_EN, true);
+    meta.muteMode = prefs.getBool(KEY_MUTE_MODE, false);
+    meta.doseChecked = false;
+}
+
+void Storage::saveDoses(const DoseTable& doses, uint16_t day) {
     if (!initialized) return;
     
-    // Save count
-    prefs.putUChar(KEY_DOSE_COUNT, count);
+    uint16_t count = min(doses.count, (uint16_t)MAX_DOSES);
     
-    // Serialize doses to byte array
-    // Format: [hour, minute, isPM, enabled] for each dose
-    uint8_t buffer[MAX_DOSES * 4];
-    
-    for (uint8_t i = 0; i < count; i++) {
-        uint8_t offset = i * 4;
-        buffer[offset] = doses[i].time.hour;
-        buffer[offset + 1] = doses[i].time.minute;
-        buffer[offset + 2] = (doses[i].time.isPM ? 1 : 0);
-        buffer[offset + 3] = (doses[i].enabled ? 1 : 0);
+    // Count is implied by the blob length; an empty schedule has no blob
+    if (count == 0) {
+        if (meta.doseLength != 0) {
+            prefs.remove(KEY_DOSES);
+            nvsStats.writes++;
+            meta.doseLength = 0;
+        }
+        meta.doseChecked = true;
+        meta.doseValid = true;
+        DEBUG_PRINTLN("Saved 0 doses to storage");
+        return;
     }
     
-    prefs.putBytes(KEY_DOSES, buffer, count * 4);
+    // Serialize doses to byte array
+    // Format: [minute lo, minute hi, flags] for each dose
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t offset = i * DOSE_RECORD_SIZE;
+        doseBuffer[offset] = doses.minutes[i] & 0xFF;
+        doseBuffer[offset + 1] = doses.minutes[i] >> 8;
+        doseBuffer[offset + 2] = ((doses.flags[i] & DOSE_FLAG_ENABLED) ? RECORD_FLAG_ENABLED : 0) |
+                                 ((doses.flags[i] & DOSE_FLAG_TAKEN) ? RECORD_FLAG_TAKEN : 0) |
+                                 (doses.compartments[i] << RECORD_COMPARTMENT_SHIFT);
+    }
     
-    // Save CRC
-    uint8_t crc = calculateCRC(buffer, count * 4);
-    prefs.putUChar(KEY_CRC, crc);
+    uint16_t length = packDoseBlocks(count);
+    prefs.putBytes(KEY_DOSES, doseBuffer, length);
+    nvsStats.writes++;
+    meta.doseLength = length;
+    meta.doseChecked = true;
+    meta.doseValid = true;
+    
+    // Day stamp goes last: if power fails before it is written, the new
+    // taken flags are dropped on load rather than applied to the wrong day
+    if (meta.takenDay != day) {
+        prefs.putUShort(KEY_TAKEN_DAY, day);
+        nvsStats.writes++;
+        meta.takenDay = day;
+    }
     
     DEBUG_PRINTF("Saved %d doses to storage\n", count);
 }
 
-uint8_t Storage::loadDoses(Dose* doses) {
+uint16_t Storage::loadDoses(DoseTable& doses, uint16_t today) {
     if (!initialized) return 0;
     
-    uint8_t count = prefs.getUChar(KEY_DOSE_COUNT, 0);
+    size_t length = meta.doseLength;
+    uint16_t count = doseCountForLength(length);
     
-    if (count == 0 || count > MAX_DOSES) {
+    if (count == 0) {
+        if (length != 0) {
+            DEBUG_PRINTLN("ERROR: Dose data has an invalid length");
+        }
         return 0;
     }
     
     // Load dose data
-    uint8_t buffer[MAX_DOSES * 4];
-    size_t bytesRead = prefs.getBytes(KEY_DOSES, buffer, count * 4);
+    size_t bytesRead = prefs.getBytes(KEY_DOSES, doseBuffer, length);
+    nvsStats.reads++;
     
-    if (bytesRead != count * 4) {
+    if (bytesRead != length) {
         DEBUG_PRINTLN("ERROR: Dose data corrupted");
         return 0;
     }
     
-    // Verify CRC
-    uint8_t storedCrc = prefs.getUChar(KEY_CRC, 0);
-    uint8_t calculatedCrc = calculateCRC(buffer, count * 4);
+    // Verify each block; a bad one loses its own doses, not the schedule
+    count = unpackDoseBlocks(count, skippedDoses);
+    meta.doseChecked = true;
+    meta.doseValid = (skippedDoses == 0);
     
-    if (storedCrc != calculatedCrc) {
-        DEBUG_PRINTLN("ERROR: Dose data CRC mismatch");
-        return 0;
-    }
+    // Taken flags only survive a reboot on the day they were saved
+    bool keepTaken = meta.takenDay == today;
     
     // Deserialize doses
-    for (uint8_t i = 0; i < count; i++) {
-        uint8_t offset = i * 4;
-        doses[i].time.hour = buffer[offset];
-        doses[i].time.minute = buffer[offset + 1];
-        doses[i].time.isPM = (buffer[offset + 2] == 1);
-        doses[i].enabled = (buffer[offset + 3] == 1);
-        doses[i].taken = false;  // Reset taken status on load
-        doses[i].id = i;
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t offset = i * DOSE_RECORD_SIZE;
+        doses.minutes[i] = doseBuffer[offset] | (doseBuffer[offset + 1] << 8);
+        doses.flags[i] = (doseBuffer[offset + 2] & RECORD_FLAG_ENABLED) ? DOSE_FLAG_ENABLED : 0;
+        if (keepTaken && (doseBuffer[offset + 2] & RECORD_FLAG_TAKEN)) {
+            doses.flags[i] |= DOSE_FLAG_TAKEN;
+        }
+        doses.compartments[i] = doseBuffer[offset + 2] >> RECORD_COMPARTMENT_SHIFT;
     }
     
     DEBUG_PRINTF("Loaded %d doses from storage\n", count);
     return count;
 }
 
-void Storage::saveSettings(bool alarmEnabled, bool muteMode) {
+void Storage::saveSettings(bool alarm, bool mute) {
     if (!initialized) return;
     
-    prefs.putBool(KEY_ALARM_EN, alarmEnabled);
-    prefs.putBool(KEY_MUTE_MODE, muteMode);
+    settingsStats.requested++;
+    alarmEnabled = alarm;
+    muteMode = mute;
     
-    DEBUG_PRINTLN("Settings saved");
+    // Toggling back to the stored value cancels the pending write
+    settingsDirty = (alarmEnabled != meta.alarmEnabled) || (muteMode != meta.muteMode);
+    settingsChangedAt = millis();
 }
 
-void Storage::loadSettings(bool& alarmEnabled, bool& muteMode) {
+void Storage::loadSettings(bool& alarm, bool& mute) {
     if (!initialized) {
-        alarmEnabled = true;
-        muteMode = false;
+        alarm = true;
+        mute = false;
         return;
     }
     
-    alarmEnabled = prefs.getBool(KEY_ALARM_EN, true);
-    muteMode = prefs.getBool(KEY_MUTE_MODE, false);
+    alarm = alarmEnabled;
+    mute = muteMode;
     
-    DEBUG_PRINTF("Settings loaded: alarm=%d, mute=%d\n", alarmEnabled, muteMode);
+    DEBUG_PRINTF("Settings loaded: alarm=%d, mute=%d\n", alarm, mute);
 }
 
-void Storage::logLidOpening(uint32_t timestamp, int8_t doseIndex, bool wasOnTime) {
-    if (!initialized) return;
+void Storage::update() {
+    if (settingsDirty && millis() - settingsChangedAt >= SETTINGS_SAVE_DELAY) {
+        writeSettings();
+    }
+    eventLog.update();
+}
+
+void Storage::flush() {
+    if (settingsDirty) {
+        writeSettings();
+    }
+    eventLog.flush();
+}
+
+void Storage::writeSettings() {
+    uint32_t start = micros();
+    
+    if (alarmEnabled != meta.alarmEnabled) {
+        prefs.putBool(KEY_ALARM_EN, alarmEnabled);
+        meta.alarmEnabled = alarmEnabled;
+        settingsStats.performed++;
+        nvsStats.writes++;
+    }
+    if (muteMode != meta.muteMode) {
+        prefs.putBool(KEY_MUTE_MODE, muteMode);
+        meta.muteMode = muteMode;
+        settingsStats.performed++;
+        nvsStats.writes++;
+    }
     
-    uint16_t logCount = prefs.getUShort(KEY_LOG_COUNT, 0);
+    uint32_t elapsed = micros() - start;
+    settingsStats.flashTimeUs += elapsed;
+    settingsStats.maxWriteUs = max(settingsStats.maxWriteUs, elapsed);
+    settingsDirty = false;
     
-    // Implement circular buffer for logs
-    uint8_t logIndex = logCount % MAX_LOG_ENTRIES;
+    DEBUG_PRINTLN("Settings saved");
+}
+
+void Storage::logLidOpening(uint32_t timestamp, int16_t doseIndex, bool wasOnTime) {
+    if (!initialized) return;
     
-    // Create log entry
     LogEntry entry;
     entry.timestamp = timestamp;
-    entry.doseIndex = (doseIndex >= 0) ? doseIndex : 255;
+    entry.doseIndex = (doseIndex >= 0) ? doseIndex : 0xFFFF;
     entry.wasOnTime = wasOnTime;
     
-    // Create key for this log entry
-    char logKey[16];
-    sprintf(logKey, "log%d", logIndex);
-    
-    // Store as bytes
-    prefs.putBytes(logKey, &entry, sizeof(LogEntry));
-    
-    // Update count
-    logCount++;
-    prefs.putUShort(KEY_LOG_COUNT, logCount);
+    // Buffered: reaches flash with the next batch
+    eventLog.append(entry);
     
     DEBUG_PRINTF("Logged lid opening at %lu\n", timestamp);
 }
 
-uint8_t Storage::getLogs(LogEntry* logs, uint8_t maxEntries) {
+uint16_t Storage::getLogs(LogEntry* logs, uint16_t maxEntries) {
     if (!initialized) return 0;
     
-    uint16_t totalLogs = prefs.getUShort(KEY_LOG_COUNT, 0);
-    
-    if (totalLogs == 0) return 0;
-    
-    uint8_t entriesToRead = min((uint16_t)maxEntries, min(totalLogs, (uint16_t)MAX_LOG_ENTRIES));
-    
-    // Calculate starting index for circular buffer
-    uint16_t startIndex = 0;
-    if (totalLogs > MAX_LOG_ENTRIES) {
-        startIndex = totalLogs % MAX_LOG_ENTRIES;
-    }
-    
-    for (uint8_t i = 0; i < entriesToRead; i++) {
-        uint8_t logIndex = (startIndex + i) % MAX_LOG_ENTRIES;
-        
-        char logKey[16];
-        sprintf(logKey, "log%d", logIndex);
-        
-        prefs.getBytes(logKey, &logs[i], sizeof(LogEntry));
-    }
+    uint32_t end = eventLog.getEndId();
+    uint32_t id = (end > maxEntries) ? end - maxEntries : 0;
     
-    return entriesToRead;
+    return eventLog.read(id, logs, maxEntries);
 }
 
-uint16_t Storage::getLogCount() {
+uint16_t Storage::getLogsInRange(uint32_t from, uint32_t to, uint32_t& cursor,
+                                 LogEntry* logs, uint16_t maxEntries) {
     if (!initialized) return 0;
-    return prefs.getUShort(KEY_LOG_COUNT, 0);
+    return eventLog.readRange(from, to, cursor, logs, maxEntries);
+}
+
+uint32_t Storage::getLogCount() {
+    if (!initialized) return 0;
+    return eventLog.getCount();
 }
 
 void Storage::clearLogs() {
     if (!initialized) return;
-    
-    prefs.putUShort(KEY_LOG_COUNT, 0);
-    
-    // Clear individual log entries
-    for (uint8_t i = 0; i < MAX_LOG_ENTRIES; i++) {
-        char logKey[16];
-        sprintf(logKey, "log%d", i);
-        prefs.remove(logKey);
-    }
-    
-    DEBUG_PRINTLN("Logs cleared");
+    eventLog.clear();
 }
 
 void Storage::saveLastDay(uint8_t day) {
-    if (!initialized) return;
+    if (!initialized || day == meta.lastDay) return;
     prefs.putUChar(KEY_LAST_DAY, day);
+    nvsStats.writes++;
+    meta.lastDay = day;
 }
 
 uint8_t Storage::loadLastDay() {
     if (!initialized) return 0;
-    return prefs.getUChar(KEY_LAST_DAY, 0);
+    return meta.lastDay;
 }
 
 bool Storage::verifyIntegrity() {
     if (!initialized) return false;
     
-    uint8_t count = prefs.getUChar(KEY_DOSE_COUNT, 0);
+    size_t length = meta.doseLength;
     
-    if (count == 0) {
+    if (length == 0) {
         return true;  // No data to verify
     }
     
-    // Load and verify CRC
-    uint8_t buffer[MAX_DOSES * 4];
-    size_t bytesRead = prefs.getBytes(KEY_DOSES, buffer, count * 4);
-    
-    if (bytesRead != count * 4) {
+    uint16_t count = doseCountForLength(length);
+    if (count == 0) {
         return false;
     }
     
-    uint8_t storedCrc = prefs.getUChar(KEY_CRC, 0);
-    uint8_t calculatedCrc = calculateCRC(buffer, count * 4);
+    if (!meta.doseChecked) {
+        // Load and verify every block's CRC
+        size_t bytesRead = prefs.getBytes(KEY_DOSES, doseBuffer, length);
+        nvsStats.reads++;
+        
+        uint16_t skipped = 0;
+        if (bytesRead == length) {
+            unpackDoseBlocks(count, skipped);
+        }
+        meta.doseChecked = true;
+        meta.doseValid = (bytesRead == length) && (skipped == 0);
+    }
     
-    return (storedCrc == calculatedCrc);
+    return meta.doseValid;
 }
 
 void Storage::factoryReset() {
@@ -253,22 +420,32 @@ void Storage::factoryReset() {
     
     // Reinitialize with defaults
     prefs.putUChar(KEY_VERSION, STORAGE_VERSION);
-    prefs.putUChar(KEY_DOSE_COUNT, 0);
     prefs.putBool(KEY_ALARM_EN, true);
     prefs.putBool(KEY_MUTE_MODE, false);
     prefs.putUChar(KEY_LAST_DAY, 0);
-    prefs.putUShort(KEY_LOG_COUNT, 0);
+    eventLog.clear();
+    nvsStats.writes += 5;
+    
+    memset(&meta, 0, sizeof(meta));
+    meta.version = STORAGE_VERSION;
+    meta.alarmEnabled = alarmEnabled = true;
+    meta.muteMode = muteMode = false;
+    meta.doseChecked = true;
+    meta.doseValid = true;
+    skippedDoses = 0;
+    settingsDirty = false;
     
     DEBUG_PRINTLN("Factory reset complete");
 }
 
 uint8_t Storage::getVersion() {
     if (!initialized) return 0;
-    return prefs.getUChar(KEY_VERSION, 0);
+    return meta.version;
 }
 
 size_t Storage::getFreeSpace() {
     if (!initialized) return 0;
+    nvsStats.reads++;
     return prefs.freeEntries();
 }
 
@@ -290,10 +467,218 @@ uint8_t Storage::calculateCRC(uint8_t* data, size_t length) {
 }
 
 void Storage::migrateData(uint8_t oldVersion) {
+    // One step per format change, oldest first. Each step upgrades the
+    // store by one version and may be cut short by a power failure at any
+    // point: it keeps its progress in the migration cursor and leaves its
+    // inputs intact until the converted data is in place.
+    static const Migration steps[] = {
+        { 2, &Storage::migrateDosesV1 },
+        { 3, &Storage::migrateV2 },
+        { 4, &Storage::migrateV3 },
+        { 5, &Storage::migrateV4 },
+    };
+    static_assert(sizeof(steps) / sizeof(steps[0]) == STORAGE_VERSION - 1, "Missing migration step");
+    
     DEBUG_PRINTF("Migrating storage from version %d to %d\n", oldVersion, STORAGE_VERSION);
     
-    // Add migration logic here for future versions
-    // For now, just update the version
+    for (const Migration& step : steps) {
+        if (step.toVersion <= oldVersion) continue;
+        
+        // A cursor left by another step is stale: start this one from 0
+        migrationVersion = step.toVersion;
+        if (prefs.getULong(KEY_MIGRATION, 0) >> 24 != migrationVersion) {
+            setMigrationCursor(0);
+        }
+        
+        (this->*step.upgrade)();
+        
+        // Commit marker: the step is only done once the version says so
+        prefs.putUChar(KEY_VERSION, step.toVersion);
+        DEBUG_PRINTF("Storage now at version %d\n", step.toVersion);
+    }
     
-    prefs.putUChar(KEY_VERSION, STORAGE_VERSION);
+    prefs.remove(KEY_MIGRATION);
+}
+
+uint32_t Storage::migrationCursor() {
+    return prefs.getULong(KEY_MIGRATION, 0) & 0xFFFFFF;
+}
+
+void Storage::setMigrationCursor(uint32_t position) {
+    prefs.putULong(KEY_MIGRATION, ((uint32_t)migrationVersion << 24) | position);
+}
+
+size_t Storage::loadStagedDoses() {
+    size_t length = prefs.getBytesLength(KEY_STAGED_DOSES);
+    
+    if (length == 0 || length > sizeof(doseBuffer) ||
+        prefs.getBytes(KEY_STAGED_DOSES, doseBuffer, length) != length) {
+        return 0;
+    }
+    
+    return length;
+}
+
+void Storage::migrateDosesV1() {
+    // 0: convert v1 records into the staged blob
+    if (migrationCursor() < 1) {
+        uint8_t count = prefs.getUChar(KEY_DOSE_COUNT, 0);
+        size_t length = prefs.getBytesLength(KEY_DOSES);
+        
+        // v1 format: [hour, minute, isPM, enabled] for each dose
+        uint8_t oldBuffer[V1_MAX_DOSES * 4];
+        
+        if (count > 0 && count <= V1_MAX_DOSES && length == count * 4U &&
+            prefs.getBytes(KEY_DOSES, oldBuffer, length) == length &&
+            prefs.getUChar(KEY_CRC, 0) == calculateCRC(oldBuffer, length)) {
+            for (uint8_t i = 0; i < count; i++) {
+                uint8_t offset = i * 4;
+                Time12H time(oldBuffer[offset], oldBuffer[offset + 1], oldBuffer[offset + 2] == 1);
+                MinuteOfDay minutes = toMinuteOfDay(time);
+                doseBuffer[i * DOSE_RECORD_SIZE] = minutes & 0xFF;
+                doseBuffer[i * DOSE_RECORD_SIZE + 1] = minutes >> 8;
+                doseBuffer[i * DOSE_RECORD_SIZE + 2] = (oldBuffer[offset + 3] == 1) ? RECORD_FLAG_ENABLED : 0;
+            }
+            prefs.putBytes(KEY_STAGED_DOSES, doseBuffer, count * DOSE_RECORD_SIZE);
+        } else if (length != 0) {
+            DEBUG_PRINTLN("WARNING: v1 dose data invalid, discarding");
+            prefs.remove(KEY_DOSES);
+        }
+        
+        setMigrationCursor(1);
+    }
+    
+    // 1: swap it in with its CRC (repeatable until the staged copy is gone)
+    if (migrationCursor() < 2) {
+        size_t length = loadStagedDoses();
+        if (length != 0) {
+            prefs.putBytes(KEY_DOSES, doseBuffer, length);
+            prefs.putUChar(KEY_CRC, calculateCRC(doseBuffer, length));
+            prefs.remove(KEY_STAGED_DOSES);
+            DEBUG_PRINTF("Migrated %d doses to v2 records\n", (int)(length / DOSE_RECORD_SIZE));
+        }
+        
+        setMigrationCursor(2);
+    }
+}
+
+void Storage::migrateV2() {
+    // Dose count is now implied by the blob length (and can exceed 255)
+    prefs.remove(KEY_DOSE_COUNT);
+    
+    // Log dose index widened from uint8_t (255 = none) to uint16_t. Both
+    // layouts are 8 bytes, so each record goes through a staging key: even
+    // positions convert record n into it, odd positions copy it back.
+    uint16_t logCount = min(prefs.getUShort(KEY_LOG_COUNT, 0), (uint16_t)MAX_LOG_ENTRIES);
+    
+    for (uint32_t position = migrationCursor(); position < logCount * 2U; position++) {
+        char logKey[16];
+        sprintf(logKey, "log%lu", (unsigned long)(position / 2));
+        
+        if (position % 2 == 0) {
+            // v2 layout: timestamp (4), doseIndex (1), wasOnTime (1), padding (2)
+            uint8_t old[8];
+            if (prefs.getBytes(logKey, old, sizeof(old)) == sizeof(old)) {
+                LogEntry entry;
+                memcpy(&entry.timestamp, old, sizeof(entry.timestamp));
+                entry.doseIndex = (old[4] == 255) ? 0xFFFF : old[4];
+                entry.wasOnTime = old[5] != 0;
+                prefs.putBytes(KEY_STAGED_LOG, &entry, sizeof(LogEntry));
+            } else {
+                prefs.remove(KEY_STAGED_LOG);
+            }
+        } else {
+            LogEntry entry;
+            if (prefs.getBytes(KEY_STAGED_LOG, &entry, sizeof(LogEntry)) == sizeof(LogEntry)) {
+                prefs.putBytes(logKey, &entry, sizeof(LogEntry));
+            }
+        }
+        
+        setMigrationCursor(position + 1);
+    }
+    
+    prefs.remove(KEY_STAGED_LOG);
+    DEBUG_PRINTF("Migrated %d log entries to v3\n", logCount);
+}
+
+void Storage::migrateV3() {
+    if (!eventLog.isReady()) {
+        DEBUG_PRINTLN("WARNING: No event log partition, NVS logs left in place");
+        return;
+    }
+    
+    uint16_t logCount = prefs.getUShort(KEY_LOG_COUNT, 0);
+    uint16_t stored = min(logCount, (uint16_t)MAX_LOG_ENTRIES);
+    uint16_t start = (logCount > MAX_LOG_ENTRIES) ? logCount % MAX_LOG_ENTRIES : 0;
+    
+    // 0: note where the copies will start in the event log
+    if (migrationCursor() < 1) {
+        prefs.putULong(KEY_MIGRATION_BASE, eventLog.getEndId());
+        setMigrationCursor(1);
+    }
+    
+    // 1: copy the circular buffer oldest first. Records that reached the
+    // event log before a restart are not copied again.
+    if (migrationCursor() < 2) {
+        uint32_t base = prefs.getULong(KEY_MIGRATION_BASE, 0);
+        uint32_t end = eventLog.getEndId();
+        uint32_t copied = (end >= base) ? end - base : 0;
+        uint16_t moved = 0;
+        
+        for (uint16_t i = 0; i < stored; i++) {
+            char logKey[16];
+            sprintf(logKey, "log%d", (start + i) % MAX_LOG_ENTRIES);
+            
+            LogEntry entry;
+            if (prefs.getBytes(logKey, &entry, sizeof(LogEntry)) != sizeof(LogEntry)) continue;
+            if (moved++ < copied) continue;
+            
+            eventLog.append(entry);
+        }
+        
+        eventLog.flush();
+        setMigrationCursor(2);
+        DEBUG_PRINTF("Moved %d log entries to the event log\n", moved);
+    }
+    
+    // 2: the copies are on flash, drop the per-entry keys
+    for (uint16_t i = 0; i < stored; i++) {
+        char logKey[16];
+        sprintf(logKey, "log%d", i);
+        prefs.remove(logKey);
+    }
+    prefs.remove(KEY_LOG_COUNT);
+    prefs.remove(KEY_MIGRATION_BASE);
+}
+
+void Storage::migrateV4() {
+    // 0: repack the CRC-8 checked blob into CRC-32 blocks, staged
+    if (migrationCursor() < 1) {
+        size_t length = prefs.getBytesLength(KEY_DOSES);
+        uint16_t count = length / DOSE_RECORD_SIZE;
+        
+        if (count > 0 && count <= MAX_DOSES && length % DOSE_RECORD_SIZE == 0 &&
+            prefs.getBytes(KEY_DOSES, doseBuffer, length) == length &&
+            prefs.getUChar(KEY_CRC, 0) == calculateCRC(doseBuffer, length)) {
+            prefs.putBytes(KEY_STAGED_DOSES, doseBuffer, packDoseBlocks(count));
+        } else if (length != 0) {
+            DEBUG_PRINTLN("WARNING: v4 dose data invalid, discarding");
+            prefs.remove(KEY_DOSES);
+        }
+        
+        setMigrationCursor(1);
+    }
+    
+    // 1: swap it in and drop the old CRC key
+    if (migrationCursor() < 2) {
+        size_t length = loadStagedDoses();
+        if (length != 0) {
+            prefs.putBytes(KEY_DOSES, doseBuffer, length);
+            prefs.remove(KEY_STAGED_DOSES);
+            DEBUG_PRINTF("Migrated %d doses to CRC-32 blocks\n", doseCountForLength(length));
+        }
+        prefs.remove(KEY_CRC);
+        
+        setMigrationCursor(2);
+    }
 }
@@ -11,15 +11,44 @@
 #include <Arduino.h>
 #include <Preferences.h>
 #include "config.h"
+#include "EventLog.h"
 
 // Forward declarations
 class DoseManager;
 
-// Log entry structure
-struct LogEntry {
-    uint32_t timestamp;     // Unix timestamp
-    uint8_t doseIndex;      // Which dose was taken
-    bool wasOnTime;         // Was it taken on time
+/**
+ * @brief Settings write accounting (see Storage::saveSettings)
+ */
+struct SettingsWriteStats {
+    uint32_t requested;     // saveSettings() calls
+    uint32_t performed;     // NVS key writes actually made
+    uint32_t flashTimeUs;   // Total time spent in those writes
+    uint32_t maxWriteUs;    // Longest single write
+};
+
+/**
+ * @brief NVS operations made since begin() (see Storage::getNvsStats)
+ */
+struct NvsStats {
+    uint32_t reads;
+    uint32_t writes;        // Puts and removes
+};
+
+/**
+ * @brief RAM copy of the NVS metadata, loaded once in begin()
+ *
+ * Reads are served from here; writes go to flash and then update it, so
+ * it always matches what is stored.
+ */
+struct StorageMeta {
+    uint8_t version;
+    uint8_t lastDay;
+    uint16_t takenDay;      // Day the stored taken flags belong to
+    uint16_t doseLength;    // Dose blob bytes (0 = no blob)
+    bool alarmEnabled;      // Settings as stored
+    bool muteMode;
+    bool doseChecked;       // doseValid holds the blob's CRC checks
+    bool doseValid;
 };
 
 class Storage {
@@ -32,22 +61,34 @@ public:
     
     /**
      * @brief Save doses to storage
-     * @param doses Array of doses
-     * @param count Number of doses
+     * @param doses Dose table to save, including taken flags
+     * @param day Day number the taken flags belong to
      */
-    void saveDoses(Dose* doses, uint8_t count);
+    void saveDoses(const DoseTable& doses, uint16_t day);
     
     /**
      * @brief Load doses from storage
-     * @param doses Array to load into
+     * @param doses Table to load into (count is not updated)
+     * @param today Current day number; taken flags saved on another day
+     *              are cleared
      * @return Number of doses loaded
+     * @note Doses in a block that fails its CRC are skipped and counted in
+     *       getSkippedDoses(); the rest of the schedule still loads
+     */
+    uint16_t loadDoses(DoseTable& doses, uint16_t today);
+    
+    /**
+     * @brief Get the doses dropped by the last load for failing their CRC
+     * @return Skipped dose count
      */
-    uint8_t loadDoses(Dose* doses);
+    uint16_t getSkippedDoses() const { return skippedDoses; }
     
     /**
      * @brief Save system settings
      * @param alarmEnabled Alarm enabled state
      * @param muteMode Mute mode state
+     * @note Only updates the RAM copy. update() writes it SETTINGS_SAVE_DELAY
+     *       after the last change, and only the keys that differ from flash.
      */
     void saveSettings(bool alarmEnabled, bool muteMode);
     
@@ -58,33 +99,73 @@ public:
      */
     void loadSettings(bool& alarmEnabled, bool& muteMode);
     
+    /**
+     * @brief Get settings write accounting
+     * @return Requested versus performed writes
+     */
+    const SettingsWriteStats& getSettingsWriteStats() const { return settingsStats; }
+    
+    /**
+     * @brief Get NVS operation counts
+     * @return Reads and writes since begin()
+     */
+    const NvsStats& getNvsStats() const { return nvsStats; }
+    
     /**
      * @brief Log a lid opening event
      * @param timestamp Unix timestamp of event
      * @param doseIndex Index of related dose (-1 if none)
      * @param wasOnTime Was the opening on time for the dose
      */
-    void logLidOpening(uint32_t timestamp, int8_t doseIndex = -1, bool wasOnTime = false);
+    void logLidOpening(uint32_t timestamp, int16_t doseIndex = -1, bool wasOnTime = false);
     
     /**
-     * @brief Get log entries
-     * @param logs Array to fill with log entries
+     * @brief Get the most recent log entries
+     * @param logs Array to fill with log entries (oldest first)
      * @param maxEntries Maximum entries to retrieve
      * @return Number of entries retrieved
      */
-    uint8_t getLogs(LogEntry* logs, uint8_t maxEntries);
+    uint16_t getLogs(LogEntry* logs, uint16_t maxEntries);
+    
+    /**
+     * @brief Get log entries in a time range
+     * @param from First Unix time wanted (inclusive)
+     * @param to Last Unix time wanted (inclusive)
+     * @param cursor Record id to resume at (0 to start); advanced for the next page
+     * @param logs Array to fill (oldest first)
+     * @param maxEntries Maximum entries to retrieve
+     * @return Number of entries retrieved; fewer than maxEntries ends the range
+     */
+    uint16_t getLogsInRange(uint32_t from, uint32_t to, uint32_t& cursor,
+                            LogEntry* logs, uint16_t maxEntries);
     
     /**
      * @brief Get total number of log entries
      * @return Number of logged events
      */
-    uint16_t getLogCount();
+    uint32_t getLogCount();
     
     /**
      * @brief Clear all logs
      */
     void clearLogs();
     
+    /**
+     * @brief Get the event log (for sequential reads by record id)
+     * @return Event log reference
+     */
+    EventLog& getEventLog() { return eventLog; }
+    
+    /**
+     * @brief Write settings and buffered log entries once due (call every loop)
+     */
+    void update();
+    
+    /**
+     * @brief Write settings and buffered log entries now (call before sleep or restart)
+     */
+    void flush();
+    
     /**
      * @brief Save last known date (for midnight detection)
      * @param day Day of month
@@ -100,6 +181,8 @@ public:
     /**
      * @brief Check data integrity
      * @return true if data is valid
+     * @note The dose blob is read at most once; the result is kept until
+     *       the next save
      */
     bool verifyIntegrity();
     
@@ -122,10 +205,33 @@ public:
 
 private:
     Preferences prefs;
+    EventLog eventLog;
     bool initialized;
     
+    StorageMeta meta;
+    NvsStats nvsStats;
+    uint16_t skippedDoses;
+    uint8_t migrationVersion;       // Version the running migration step produces
+    
+    // Settings: RAM copy (meta holds the values last written to flash)
+    bool alarmEnabled;
+    bool muteMode;
+    bool settingsDirty;
+    uint32_t settingsChangedAt;     // millis() of the latest change
+    SettingsWriteStats settingsStats;
+    
+    /**
+     * @brief Read the metadata keys other than the version into meta
+     */
+    void loadMeta();
+    
     /**
-     * @brief Calculate CRC for data integrity
+     * @brief Write the settings keys that differ from flash
+     */
+    void writeSettings();
+    
+    /**
+     * @brief Calculate the CRC-8 of a v4 and earlier dose blob
      * @param data Data to checksum
      * @param length Data length
      * @return CRC value
@@ -133,10 +239,49 @@ private:
     uint8_t calculateCRC(uint8_t* data, size_t length);
     
     /**
-     * @brief Migrate data from old versions
+     * @brief Migrate data from old versions, one step per version
      * @param oldVersion Previous storage version
+     * @note Resumes where it stopped if power failed during an earlier run
      */
     void migrateData(uint8_t oldVersion);
+    
+    /**
+     * @brief Get the running migration step's progress
+     * @return Position saved by setMigrationCursor() (0 if none)
+     */
+    uint32_t migrationCursor();
+    
+    /**
+     * @brief Save the running migration step's progress
+     * @param position Step-defined position (24 bits)
+     */
+    void setMigrationCursor(uint32_t position);
+    
+    /**
+     * @brief Read the staged dose blob into the serialization buffer
+     * @return Blob length (0 if there is none)
+     */
+    size_t loadStagedDoses();
+    
+    /**
+     * @brief v1 to v2: convert dose records (hour, minute, isPM, enabled)
+     */
+    void migrateDosesV1();
+    
+    /**
+     * @brief v2 to v3: drop the dose count key and widen log dose indices
+     */
+    void migrateV2();
+    
+    /**
+     * @brief v3 to v4: move the per-key NVS logs into the event log partition
+     */
+    void migrateV3();
+    
+    /**
+     * @brief v4 to v5: replace the dose blob's CRC-8 key with per-block CRC-32s
+     */
+    void migrateV4();
 };
 
 #endif // STORAGE_H
@@ -0,0 +1,26 @@
+/**
+ * @file TextMetrics.cpp
+ * @brief Built-in font text width implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "TextMetrics.h"
+
+int16_t textWidth(const char* text, uint8_t size, int16_t lineWidth) {
+    int16_t cell = FONT_CHAR_WIDTH * size;
+    int16_t longest = 0;
+    int16_t current = 0;
+    
+    for (; *text; text++) {
+        if (*text == '\n') {
+            current = 0;
+        } else if (*text != '\r') {
+            current++;
+            if (current > longest) longest = current;
+        }
+    }
+    
+    int16_t perLine = lineWidth / cell;
+    return (longest < perLine ? longest : perLine) * cell;
+}
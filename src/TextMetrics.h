@@ -0,0 +1,52 @@
+/**
+ * @file TextMetrics.h
+ * @brief Text widths for the built-in GFX font, without glyph walks
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * The built-in font draws every character in a fixed 6x8 cell, scaled by
+ * the text size, so a width is a character count times the cell width.
+ * Fixed strings get theirs at compile time; others are counted once.
+ *
+ * No Arduino dependencies, so the metrics also build on a host.
+ */
+
+#ifndef TEXT_METRICS_H
+#define TEXT_METRICS_H
+
+#include <stdint.h>
+
+// Built-in GFX font: 5x7 glyphs in a 6x8 cell, scaled by text size
+#define FONT_CHAR_WIDTH     6
+#define FONT_CHAR_HEIGHT    8
+
+/**
+ * @brief Length of a string, usable in constant expressions
+ */
+constexpr int16_t constStrLen(const char* text) {
+    return *text ? 1 + constStrLen(text + 1) : 0;
+}
+
+/**
+ * @brief Fixed single-line string with its pixel width precomputed
+ */
+struct FixedText {
+    const char* text;
+    uint8_t size;
+    int16_t width;
+    
+    constexpr FixedText(const char* t, uint8_t s)
+        : text(t), size(s), width(constStrLen(t) * FONT_CHAR_WIDTH * s) {}
+};
+
+/**
+ * @brief Pixel width of text in the built-in font
+ * @param text Text to measure
+ * @param size GFX text size multiplier
+ * @param lineWidth Width GFX wraps text at
+ * @return Width in pixels: the widest line, capped where GFX would wrap,
+ *         the same as getTextBounds() for text drawn from x = 0
+ */
+int16_t textWidth(const char* text, uint8_t size, int16_t lineWidth);
+
+#endif // TEXT_METRICS_H
@@ -6,44 +6,120 @@
  */
 
 #include "TimeManager.h"
+#include "I2CBus.h"
+
+volatile uint32_t TimeManager::tickUnix = 0;
+volatile uint32_t TimeManager::tickCount = 0;
+volatile uint32_t TimeManager::lastTickMillis = 0;
+
+static portMUX_TYPE tickMux = portMUX_INITIALIZER_UNLOCKED;
 
 bool TimeManager::begin() {
-    if (!rtc.begin()) {
-        DEBUG_PRINTLN("ERROR: RTC not found!");
-        return false;
+    {
+        I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+        
+        if (!rtc.begin(&i2cBus.wire())) {
+            DEBUG_PRINTLN("ERROR: RTC not found!");
+            return false;
+        }
+        
+        if (rtc.lostPower()) {
+            DEBUG_PRINTLN("WARNING: RTC lost power, setting default time");
+            // Set to a default time: 12:00:00 PM, January 1, 2024
+            rtc.adjust(DateTime(2024, 1, 1, 12, 0, 0));
+        }
+        
+        // Release INT if a wake alarm from deep sleep is still latched
+        rtc.clearAlarm(1);
+        rtc.disableAlarm(1);
+        
+        // 1 Hz square wave on INT/SQW drives the software clock
+        rtc.writeSqwPinMode(DS3231_SquareWave1Hz);
     }
     
-    if (rtc.lostPower()) {
-        DEBUG_PRINTLN("WARNING: RTC lost power, setting default time");
-        // Set to a default time: 12:00:00 PM, January 1, 2024
-        rtc.adjust(DateTime(2024, 1, 1, 12, 0, 0));
-    }
+    pinMode(RTC_INT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(RTC_INT_PIN), onSecondTick, FALLING);
     
+    clockSynced = false;
     lastCacheUpdate = 0;
-    updateCache();
+    lastResync = 0;
+    resync();
     
     DEBUG_PRINTLN("TimeManager initialized successfully");
     return true;
 }
 
-void TimeManager::updateCache() {
+void IRAM_ATTR TimeManager::onSecondTick() {
+    portENTER_CRITICAL_ISR(&tickMux);
+    tickUnix = tickUnix + 1;
+    tickCount = tickCount + 1;
+    lastTickMillis = millis();
+    portEXIT_CRITICAL_ISR(&tickMux);
+}
+
+bool TimeManager::isTickAlive() const {
+    return tickCount > 0 && (millis() - lastTickMillis) <= RTC_SQW_TIMEOUT;
+}
+
+void TimeManager::resync() {
+    uint32_t seconds;
+    {
+        I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+        seconds = rtc.now().unixtime();
+    }
+    
+    // Without the lock, a tick on the other core could write back the
+    // pre-sync second and undo a time set until the next resync
+    portENTER_CRITICAL(&tickMux);
+    tickUnix = seconds;
+    portEXIT_CRITICAL(&tickMux);
+    
+    cachedUnix = seconds;
+    lastCacheUpdate = millis();
+    lastResync = lastCacheUpdate;
+    clockSynced = true;
+}
+
+uint32_t TimeManager::currentUnix() {
     uint32_t now = millis();
+    
+    if (isTickAlive()) {
+        // Square wave running: serve the software clock, no bus traffic
+        if (!clockSynced || now - lastResync >= RTC_RESYNC_INTERVAL) {
+            resync();
+        }
+        return tickUnix;
+    }
+    
+    // No square wave (not wired or RTC fault): poll the RTC instead
+    clockSynced = false;
     if (now - lastCacheUpdate >= TIME_CHECK_INTERVAL) {
-        cachedDateTime = rtc.now();
+        uint32_t seconds;
+        {
+            I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+            seconds = rtc.now().unixtime();
+        }
+        cachedUnix = seconds;
         lastCacheUpdate = now;
     }
+    return cachedUnix;
 }
 
 Time12H TimeManager::getCurrentTime() {
-    updateCache();
-    Time12H result = convert24to12(cachedDateTime.hour());
-    result.minute = cachedDateTime.minute();
+    DateTime now(currentUnix());
+    Time12H result = convert24to12(now.hour());
+    result.minute = now.minute();
     return result;
 }
 
+MinuteOfDay TimeManager::getMinuteOfDay() {
+    DateTime now(currentUnix());
+    return toMinuteOfDay(now.hour(), now.minute());
+}
+
 uint8_t TimeManager::getCurrentHour24() {
-    updateCache();
-    return cachedDateTime.hour();
+    DateTime now(currentUnix());
+    return now.hour();
 }
 
 void TimeManager::setTime(Time12H time) {
@@ -53,19 +129,24 @@ void TimeManager::setTime(Time12H time) {
     }
     
     uint8_t hour24 = convert12to24(time);
-    DateTime current = rtc.now();
     
-    rtc.adjust(DateTime(
-        current.year(),
-        current.month(),
-        current.day(),
-        hour24,
-        time.minute,
-        0
-    ));
+    {
+        I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+        DateTime current = rtc.now();
+        
+        rtc.adjust(DateTime(
+            current.year(),
+            current.month(),
+            current.day(),
+            hour24,
+            time.minute,
+            0
+        ));
+    }
     
     lastCacheUpdate = 0; // Force cache update
-    updateCache();
+    clockSynced = false;
+    currentUnix();
     
     DEBUG_PRINTF("Time set to: %02d:%02d %s\n", 
                  time.hour, time.minute, time.isPM ? "PM" : "AM");
@@ -77,18 +158,22 @@ void TimeManager::setTime24(uint8_t hour, uint8_t minute, uint8_t second) {
         return;
     }
     
-    DateTime current = rtc.now();
-    rtc.adjust(DateTime(
-        current.year(),
-        current.month(),
-        current.day(),
-        hour,
-        minute,
-        second
-    ));
+    {
+        I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+        DateTime current = rtc.now();
+        rtc.adjust(DateTime(
+            current.year(),
+            current.month(),
+            current.day(),
+            hour,
+            minute,
+            second
+        ));
+    }
     
     lastCacheUpdate = 0;
-    updateCache();
+    clockSynced = false;
+    currentUnix();
 }
 
 void TimeManager::setDate(uint8_t day, uint8_t month, uint16_t year) {
@@ -97,43 +182,40 @@ void TimeManager::setDate(uint8_t day, uint8_t month, uint16_t year) {
         return;
     }
     
-    DateTime current = rtc.now();
-    rtc.adjust(DateTime(
-        year,
-        month,
-        day,
-        current.hour(),
-        current.minute(),
-        current.second()
-    ));
+    {
+        I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+        DateTime current = rtc.now();
+        rtc.adjust(DateTime(
+            year,
+            month,
+            day,
+            current.hour(),
+            current.minute(),
+            current.second()
+        ));
+    }
     
     lastCacheUpdate = 0;
-    updateCache();
+    clockSynced = false;
+    currentUnix();
     
     DEBUG_PRINTF("Date set to: %02d/%02d/%04d\n", day, month, year);
 }
 
 void TimeManager::getDate(uint8_t& day, uint8_t& month, uint16_t& year) {
-    updateCache();
-    day = cachedDateTime.day();
-    month = cachedDateTime.month();
-    year = cachedDateTime.year();
+    DateTime now(currentUnix());
+    day = now.day();
+    month = now.month();
+    year = now.year();
 }
 
 uint8_t TimeManager::getDayOfWeek() {
-    updateCache();
-    return cachedDateTime.dayOfTheWeek();
+    DateTime now(currentUnix());
+    return now.dayOfTheWeek();
 }
 
 uint32_t TimeManager::getUnixTime() {
-    updateCache();
-    return cachedDateTime.unixtime();
-}
-
-bool TimeManager::isTimeMatch(Time12H t1, Time12H t2) {
-    return t1.hour == t2.hour && 
-           t1.minute == t2.minute && 
-           t1.isPM == t2.isPM;
+    return currentUnix();
 }
 
 Time12H TimeManager::convert24to12(uint8_t hour24) {
@@ -170,23 +252,9 @@ uint8_t TimeManager::convert12to24(Time12H time) {
     }
 }
 
-uint16_t TimeManager::minutesUntil(Time12H target) {
-    updateCache();
-    
-    // Convert both times to minutes since midnight
-    uint16_t currentMinutes = cachedDateTime.hour() * 60 + cachedDateTime.minute();
-    
-    uint8_t targetHour24 = convert12to24(target);
-    uint16_t targetMinutes = targetHour24 * 60 + target.minute;
-    
-    if (targetMinutes > currentMinutes) {
-        return targetMinutes - currentMinutes;
-    } else if (targetMinutes < currentMinutes) {
-        // Target is tomorrow
-        return (24 * 60 - currentMinutes) + targetMinutes;
-    }
-    
-    return 0; // Times are equal
+uint16_t TimeManager::minutesUntil(MinuteOfDay target) {
+    // Target earlier than now is tomorrow
+    return minutesForward(getMinuteOfDay(), target);
 }
 
 bool TimeManager::isValidTime(Time12H time) {
@@ -194,17 +262,35 @@ bool TimeManager::isValidTime(Time12H time) {
 }
 
 bool TimeManager::lostPower() {
+    I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
     return rtc.lostPower();
 }
 
-void TimeManager::formatTime(Time12H time, char* buffer) {
-    sprintf(buffer, "%2d:%02d %s", time.hour, time.minute, time.isPM ? "PM" : "AM");
+void TimeManager::formatDate(char* buffer) {
+    DateTime now(currentUnix());
+    sprintf(buffer, "%02d/%02d/%04d", now.day(), now.month(), now.year());
 }
 
-void TimeManager::formatDate(char* buffer) {
-    updateCache();
-    sprintf(buffer, "%02d/%02d/%04d", 
-            cachedDateTime.day(), 
-            cachedDateTime.month(), 
-            cachedDateTime.year());
+bool TimeManager::setWakeAlarm(uint32_t unixTime) {
+    detachInterrupt(digitalPinToInterrupt(RTC_INT_PIN));
+    
+    I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+    
+    // INT/SQW carries either the square wave or alarms, not both
+    rtc.writeSqwPinMode(DS3231_OFF);
+    rtc.clearAlarm(1);
+    rtc.clearAlarm(2);
+    rtc.disableAlarm(2);
+    
+    if (!rtc.setAlarm1(DateTime(unixTime), DS3231_A1_Date)) {
+        DEBUG_PRINTLN("ERROR: Failed to set RTC wake alarm");
+        return false;
+    }
+    return true;
+}
+
+void TimeManager::clearWakeAlarm() {
+    I2CBusGuard bus(I2C_DEVICE_RTC, I2C_PRIORITY_HIGH);
+    rtc.clearAlarm(1);
+    rtc.disableAlarm(1);
 }
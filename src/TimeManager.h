@@ -26,6 +26,12 @@ public:
      */
     Time12H getCurrentTime();
     
+    /**
+     * @brief Get current time of day
+     * @return Minutes since midnight (0-1439)
+     */
+    MinuteOfDay getMinuteOfDay();
+    
     /**
      * @brief Get current time in 24-hour format
      * @return Hour in 24-hour format (0-23)
@@ -75,12 +81,10 @@ public:
     uint32_t getUnixTime();
     
     /**
-     * @brief Compare two times for equality (ignoring seconds)
-     * @param t1 First time
-     * @param t2 Second time
-     * @return true if times match
+     * @brief Get the current day number
+     * @return Days since 1970-01-01 in local time
      */
-    static bool isTimeMatch(Time12H t1, Time12H t2);
+    uint16_t getDayNumber() { return getUnixTime() / 86400UL; }
     
     /**
      * @brief Convert 24-hour format to 12-hour format
@@ -98,10 +102,10 @@ public:
     
     /**
      * @brief Calculate minutes until a target time
-     * @param target Target time
+     * @param target Target time of day
      * @return Minutes until target (0-1439)
      */
-    uint16_t minutesUntil(Time12H target);
+    uint16_t minutesUntil(MinuteOfDay target);
     
     /**
      * @brief Validate time values
@@ -120,24 +124,67 @@ public:
      * @brief Get formatted time string (HH:MM AM/PM)
      * @param time Time to format
      * @param buffer Output buffer (min 12 chars)
+     * @note Inline and RTC-free, so DoseManager builds on the host
      */
-    static void formatTime(Time12H time, char* buffer);
+    static void formatTime(Time12H time, char* buffer) {
+        sprintf(buffer, "%2d:%02d %s", time.hour, time.minute, time.isPM ? "PM" : "AM");
+    }
     
     /**
      * @brief Get formatted date string (DD/MM/YYYY)
      * @param buffer Output buffer (min 11 chars)
      */
     void formatDate(char* buffer);
+    
+    /**
+     * @brief Program DS3231 Alarm1 to pull INT low at a given time
+     * @param unixTime Wake time (matched on date, hour, minute, second)
+     * @return true if the alarm was written
+     * @note Switches INT/SQW from the 1 Hz square wave to alarm output
+     */
+    bool setWakeAlarm(uint32_t unixTime);
+    
+    /**
+     * @brief Disable Alarm1 and clear its flag so INT is released
+     */
+    void clearWakeAlarm();
 
 private:
     RTC_DS3231 rtc;
-    DateTime cachedDateTime;
+    volatile uint32_t cachedUnix;   // Last RTC read while polling
     uint32_t lastCacheUpdate;
+    uint32_t lastResync;
+    bool clockSynced;
+    
+    // Software clock advanced by the DS3231 1 Hz square wave. The ISR and
+    // resync() update it inside a critical section (they can run on
+    // different cores); readers take one aligned 32-bit load, so a getter
+    // always sees a whole second and derives its DateTime from that copy.
+    static volatile uint32_t tickUnix;
+    static volatile uint32_t tickCount;
+    static volatile uint32_t lastTickMillis;
+    
+    /**
+     * @brief SQW falling-edge interrupt: advance the software clock
+     */
+    static void onSecondTick();
+    
+    /**
+     * @brief Check if the square wave is arriving
+     * @return true if a tick was seen within RTC_SQW_TIMEOUT
+     */
+    bool isTickAlive() const;
+    
+    /**
+     * @brief Re-read the RTC and realign the software clock
+     */
+    void resync();
     
     /**
-     * @brief Update cached time (call periodically)
+     * @brief Get the current time, resyncing or polling the RTC when due
+     * @return Unix timestamp (one consistent snapshot)
      */
-    void updateCache();
+    uint32_t currentUnix();
 };
 
 #endif // TIME_MANAGER_H
@@ -7,6 +7,36 @@
 
 #include "UIManager.h"
 #include "TimeManager.h"
+#include "I2CBus.h"
+
+// Guards the pending/front frame hand-off between loop() and the display task
+static portMUX_TYPE frameMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Centered fixed strings with their widths resolved at compile time
+static constexpr FixedText TXT_NO_DOSES_SCHEDULED("No doses scheduled", 1);
+static constexpr FixedText TXT_MENU("MENU", 1);
+static constexpr FixedText TXT_DOSE_SETTINGS("DOSE SETTINGS", 1);
+static constexpr FixedText TXT_NO_DOSES_CONFIGURED("No doses configured", 1);
+static constexpr FixedText TXT_ADD_DOSE("ADD DOSE", 1);
+static constexpr FixedText TXT_EDIT_DOSE("EDIT DOSE", 1);
+static constexpr FixedText TXT_SET_TIME("SET TIME", 1);
+static constexpr FixedText TXT_HINT_EDIT("NEXT:Change OK:Save", 1);
+static constexpr FixedText TXT_SET_DATE("SET DATE", 1);
+static constexpr FixedText TXT_ALARM_SETTINGS("ALARM SETTINGS", 1);
+static constexpr FixedText TXT_ON("ON", 2);
+static constexpr FixedText TXT_OFF("OFF", 2);
+static constexpr FixedText TXT_HINT_TOGGLE("OK:Toggle BACK:Exit", 1);
+static constexpr FixedText TXT_WIFI_SETTINGS("WIFI SETTINGS", 1);
+static constexpr FixedText TXT_TAKE("TAKE", 2);
+static constexpr FixedText TXT_MEDICINE("MEDICINE", 2);
+static constexpr FixedText TXT_SNOOZED("SNOOZED", 1);
+static constexpr FixedText TXT_HINT_OPEN_LID("Open lid to take dose", 1);
+static constexpr FixedText TXT_HINT_CONFIRM("OK to confirm", 1);
+static constexpr FixedText TXT_HINT_CANCEL("BACK to cancel", 1);
+static constexpr FixedText TXT_ERROR("ERROR", 1);
+static constexpr FixedText TXT_HINT_ANY_BUTTON("Press any button", 1);
+static constexpr FixedText TXT_SUCCESS("SUCCESS", 1);
+
 // Pill icon bitmap (16x16)
 static const uint8_t PROGMEM pillIcon[] = {
     0x00, 0x00, 0x03, 0xC0, 0x0F, 0xF0, 0x1F, 0xF8,
@@ -38,34 +68,72 @@ static const uint8_t PROGMEM muteIcon[] = {
 };
 
 bool UIManager::begin() {
-    display = Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, -1);
+    // Keep the shared bus clock during and after Adafruit transfers
+    display = Adafruit_SSD1306(SCREEN_WIDTH, SCREEN_HEIGHT, &i2cBus.wire(), -1,
+                               I2C_BUS_CLOCK, I2C_BUS_CLOCK);
+    
+    i2cBus.acquire(I2C_DEVICE_OLED);
     
-    if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDR)) {
+    // Wire is already started by I2CBus (periphBegin = false)
+    if (!display.begin(SSD1306_SWITCHCAPVCC, OLED_ADDR, true, false)) {
+        i2cBus.release();
         DEBUG_PRINTLN("ERROR: OLED allocation failed");
         return false;
     }
     
     display.clearDisplay();
     display.setTextColor(SSD1306_WHITE);
-    display.setTextSize(1);
+    setTextSize(1);
     display.setCursor(0, 0);
     display.println("Smart Pill Box");
     display.println("Initializing...");
     display.display();
+    i2cBus.release();
+    
+    // The full-buffer transfer above leaves the panel in a known state
+    memcpy(panelShadow, display.getBuffer(), sizeof(panelShadow));
+    panelShadowValid = true;
+    bytesSentWindow = 0;
+    bytesPerSecond = 0;
+    statsWindowStart = millis();
+    
+    // Start the render pipeline; fall back to inline flushes if the task
+    // cannot be created
+    pendingFrame = frameBuffers[0];
+    frontFrame = frameBuffers[1];
+    pendingScreen = SCREEN_NONE;
+    frontScreen = SCREEN_NONE;
+    framePending = false;
+    displayTask = nullptr;
+    if (xTaskCreatePinnedToCore(displayTaskEntry, "display", DISPLAY_TASK_STACK, this,
+                                DISPLAY_TASK_PRIORITY, &displayTask, DISPLAY_TASK_CORE) != pdPASS) {
+        displayTask = nullptr;
+        DEBUG_PRINTLN("WARNING: Display task not started, flushing inline");
+    }
     
     displayOn = true;
     lastActivity = millis();
     animationFrame = 0;
     lastAnimationUpdate = 0;
+    textSize = 1;
+    invalidate();
+    memset(frameStats, 0, sizeof(frameStats));
+    frameStartUs = 0;
+    lastFrameTime = 0;
+    buildSpriteAtlas();
     
     DEBUG_PRINTLN("UIManager initialized successfully");
     return true;
 }
 
 void UIManager::displayHome(Time12H time, int16_t minutesToNextDose,
-                            uint8_t dosesTaken, uint8_t totalDoses,
+                            uint16_t dosesTaken, uint16_t totalDoses,
                             bool wifiOn, bool muteOn) {
-    if (!displayOn) return;
+    ScreenSnapshot snapshot(SCREEN_HOME);
+    snapshot.add(time).add((uint16_t)minutesToNextDose)
+            .add(dosesTaken).add(totalDoses)
+            .add((uint8_t)((wifiOn ? 1 : 0) | (muteOn ? 2 : 0)));
+    if (!beginFrame(snapshot)) return;
     
     display.clearDisplay();
     
@@ -79,7 +147,7 @@ void UIManager::displayHome(Time12H time, int16_t minutesToNextDose,
     display.drawFastHLine(0, 38, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Next dose info
-    display.setTextSize(1);
+    setTextSize(1);
     if (minutesToNextDose >= 0) {
         char buffer[32];
         if (minutesToNextDose == 0) {
@@ -93,7 +161,7 @@ void UIManager::displayHome(Time12H time, int16_t minutesToNextDose,
         }
         drawCenteredText(buffer, 42);
     } else {
-        drawCenteredText("No doses scheduled", 42);
+        drawCenteredText(TXT_NO_DOSES_SCHEDULED, 42);
     }
     
     // Progress at bottom
@@ -101,17 +169,17 @@ void UIManager::displayHome(Time12H time, int16_t minutesToNextDose,
     sprintf(progressStr, "Today: %d/%d", dosesTaken, totalDoses);
     drawCenteredText(progressStr, 54);
     
-    display.display();
+    flush();
 }
 
 void UIManager::displayMainMenu(uint8_t selection) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_MAIN_MENU).add(selection))) return;
     
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
-    drawCenteredText("MENU", 0);
+    setTextSize(1);
+    drawCenteredText(TXT_MENU, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Menu items
@@ -137,17 +205,17 @@ void UIManager::displayMainMenu(uint8_t selection) {
         }
     }
     
-    display.display();
+    flush();
 }
 
 void UIManager::displayDoseMenu(uint8_t selection) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_DOSE_MENU).add(selection))) return;
     
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
-    drawCenteredText("DOSE SETTINGS", 0);
+    setTextSize(1);
+    drawCenteredText(TXT_DOSE_SETTINGS, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Menu items
@@ -155,45 +223,55 @@ void UIManager::displayDoseMenu(uint8_t selection) {
         drawMenuItem(14 + i * 12, DOSE_MENU_ITEMS[i], i == selection);
     }
     
-    display.display();
+    flush();
 }
 
-void UIManager::displayDoseList(Dose* doses, uint8_t count, uint8_t selection) {
-    if (!displayOn) return;
+void UIManager::displayDoseList(const DoseTable& doses, uint16_t selection) {
+    uint16_t count = doses.count;
+    
+    // List scrolls so the selection is always in the last visible row
+    uint16_t startIndex = 0;
+    uint8_t visibleItems = 4;
+    
+    if (selection >= visibleItems) {
+        startIndex = selection - visibleItems + 1;
+    }
+    
+    ScreenSnapshot snapshot(SCREEN_DOSE_LIST);
+    snapshot.add(count).add(selection);
+    for (uint8_t i = 0; i < visibleItems && (startIndex + i) < count; i++) {
+        snapshot.add(doses.minutes[startIndex + i])
+                .add(doses.flags[startIndex + i])
+                .add(doses.compartments[startIndex + i]);
+    }
+    if (!beginFrame(snapshot)) return;
     
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
+    setTextSize(1);
     char title[20];
     sprintf(title, "DOSES (%d)", count);
     drawCenteredText(title, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     if (count == 0) {
-        drawCenteredText("No doses configured", 30);
-        display.display();
+        drawCenteredText(TXT_NO_DOSES_CONFIGURED, 30);
+        flush();
         return;
     }
     
     // List doses
-    uint8_t startIndex = 0;
-    uint8_t visibleItems = 4;
-    
-    if (selection >= visibleItems) {
-        startIndex = selection - visibleItems + 1;
-    }
-    
     for (uint8_t i = 0; i < visibleItems && (startIndex + i) < count; i++) {
-        uint8_t itemIndex = startIndex + i;
+        uint16_t itemIndex = startIndex + i;
         char timeStr[16];
-        TimeManager::formatTime(doses[itemIndex].time, timeStr);
+        TimeManager::formatTime(toTime12H(doses.minutes[itemIndex]), timeStr);
         
         // Add status indicator
         char line[24];
-        if (doses[itemIndex].taken) {
+        if (doses.flags[itemIndex] & DOSE_FLAG_TAKEN) {
             sprintf(line, "%s [Done]", timeStr);
-        } else if (!doses[itemIndex].enabled) {
+        } else if (!(doses.flags[itemIndex] & DOSE_FLAG_ENABLED)) {
             sprintf(line, "%s [Off]", timeStr);
         } else {
             strcpy(line, timeStr);
@@ -202,21 +280,35 @@ void UIManager::displayDoseList(Dose* doses, uint8_t count, uint8_t selection) {
         drawMenuItem(14 + i * 12, line, itemIndex == selection);
     }
     
-    display.display();
+    flush();
 }
 
 void UIManager::displayDoseEdit(Time12H time, uint8_t editField, bool isNew) {
-    if (!displayOn) return;
+    ScreenSnapshot snapshot(SCREEN_DOSE_EDIT);
+    snapshot.add(time).add(editField).add((uint8_t)isNew);
+    if (!beginFrame(snapshot)) return;
+    
+    drawTimeEditor(isNew ? TXT_ADD_DOSE : TXT_EDIT_DOSE, time, editField);
+    flush();
+}
+
+void UIManager::displayTimeEdit(Time12H time, uint8_t editField) {
+    if (!beginFrame(ScreenSnapshot(SCREEN_TIME_EDIT).add(time).add(editField))) return;
     
+    drawTimeEditor(TXT_SET_TIME, time, editField);
+    flush();
+}
+
+void UIManager::drawTimeEditor(const FixedText& title, Time12H time, uint8_t editField) {
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
-    drawCenteredText(isNew ? "ADD DOSE" : "EDIT DOSE", 0);
+    setTextSize(1);
+    drawCenteredText(title, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Time display
-    display.setTextSize(2);
+    setTextSize(2);
     char hourStr[4], minStr[4], ampmStr[4];
     sprintf(hourStr, "%2d", time.hour);
     sprintf(minStr, "%02d", time.minute);
@@ -248,7 +340,7 @@ void UIManager::displayDoseEdit(Time12H time, uint8_t editField, bool isNew) {
     display.setTextColor(SSD1306_WHITE);
     
     // AM/PM
-    display.setTextSize(1);
+    setTextSize(1);
     if (editField == 2) {
         display.fillRect(startX + 68, 28, 20, 12, SSD1306_WHITE);
         display.setTextColor(SSD1306_BLACK);
@@ -258,34 +350,24 @@ void UIManager::displayDoseEdit(Time12H time, uint8_t editField, bool isNew) {
     display.setTextColor(SSD1306_WHITE);
     
     // Instructions
-    display.setTextSize(1);
-    drawCenteredText("NEXT:Change OK:Save", 54);
-    
-    display.display();
-}
-
-void UIManager::displayTimeEdit(Time12H time, uint8_t editField) {
-    displayDoseEdit(time, editField, false);
-    
-    // Override title
-    display.fillRect(0, 0, SCREEN_WIDTH, 10, SSD1306_BLACK);
-    display.setTextSize(1);
-    drawCenteredText("SET TIME", 0);
-    display.display();
+    setTextSize(1);
+    drawCenteredText(TXT_HINT_EDIT, 54);
 }
 
 void UIManager::displayDateEdit(uint8_t day, uint8_t month, uint16_t year, uint8_t editField) {
-    if (!displayOn) return;
+    ScreenSnapshot snapshot(SCREEN_DATE_EDIT);
+    snapshot.add(day).add(month).add(year).add(editField);
+    if (!beginFrame(snapshot)) return;
     
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
-    drawCenteredText("SET DATE", 0);
+    setTextSize(1);
+    drawCenteredText(TXT_SET_DATE, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Date display
-    display.setTextSize(2);
+    setTextSize(2);
     char dayStr[4], monthStr[4], yearStr[6];
     sprintf(dayStr, "%02d", day);
     sprintf(monthStr, "%02d", month);
@@ -329,113 +411,104 @@ void UIManager::displayDateEdit(uint8_t day, uint8_t month, uint16_t year, uint8
     display.setTextColor(SSD1306_WHITE);
     
     // Instructions
-    display.setTextSize(1);
-    drawCenteredText("NEXT:Change OK:Save", 54);
+    setTextSize(1);
+    drawCenteredText(TXT_HINT_EDIT, 54);
     
-    display.display();
+    flush();
 }
 
 void UIManager::displayAlarmToggle(bool enabled) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_ALARM_TOGGLE).add((uint8_t)enabled))) return;
     
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
-    drawCenteredText("ALARM SETTINGS", 0);
+    setTextSize(1);
+    drawCenteredText(TXT_ALARM_SETTINGS, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Icon
     drawBellIcon(56, 18, false);
     
     // Status
-    display.setTextSize(2);
+    setTextSize(2);
     if (enabled) {
-        drawCenteredText("ON", 40);
+        drawCenteredText(TXT_ON, 40);
     } else {
-        drawCenteredText("OFF", 40);
+        drawCenteredText(TXT_OFF, 40);
     }
     
     // Instructions
-    display.setTextSize(1);
-    drawCenteredText("OK:Toggle BACK:Exit", 54);
+    setTextSize(1);
+    drawCenteredText(TXT_HINT_TOGGLE, 54);
     
-    display.display();
+    flush();
 }
 
 void UIManager::displayWiFiToggle(bool enabled, const char* ipAddress) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_WIFI_TOGGLE).add((uint8_t)enabled).add(ipAddress))) return;
     
     display.clearDisplay();
     
     // Title
-    display.setTextSize(1);
-    drawCenteredText("WIFI SETTINGS", 0);
+    setTextSize(1);
+    drawCenteredText(TXT_WIFI_SETTINGS, 0);
     display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
     
     // Icon
     display.drawBitmap(56, 14, wifiIcon, 16, 12, SSD1306_WHITE);
     
     // Status
-    display.setTextSize(2);
+    setTextSize(2);
     if (enabled) {
-        drawCenteredText("ON", 30);
-        display.setTextSize(1);
+        drawCenteredText(TXT_ON, 30);
+        setTextSize(1);
         if (ipAddress) {
             drawCenteredText(ipAddress, 46);
         }
     } else {
-        drawCenteredText("OFF", 34);
+        drawCenteredText(TXT_OFF, 34);
     }
     
     // Instructions
-    display.setTextSize(1);
-    drawCenteredText("OK:Toggle BACK:Exit", 54);
+    setTextSize(1);
+    drawCenteredText(TXT_HINT_TOGGLE, 54);
     
-    display.display();
+    flush();
 }
 
-void UIManager::displayAlert(uint8_t doseNumber, Time12H doseTime) {
-    if (!displayOn) return;
+void UIManager::displayAlert(uint16_t doseNumber, Time12H doseTime) {
+    ScreenSnapshot snapshot(SCREEN_ALERT);
+    snapshot.add(doseNumber).add(doseTime).add((uint8_t)(animationFrame % ALERT_SPRITE_FRAMES));
+    if (!beginFrame(snapshot)) return;
     
+    // Border, bell and alert text come pre-rendered from the atlas
+    uint8_t frame = animationFrame % ALERT_SPRITE_FRAMES;
     display.clearDisplay();
-    
-    // Animated border
-    if (animationFrame % 2 == 0) {
-        display.drawRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
-        display.drawRect(2, 2, SCREEN_WIDTH - 4, SCREEN_HEIGHT - 4, SSD1306_WHITE);
+    if (frame % 2 == 0) {
+        blitLayer(SPRITE_ALERT_BORDER);
     }
-    
-    // Bell icon (animated)
-    int16_t bellOffset = (animationFrame % 4 < 2) ? -2 : 2;
-    drawBellIcon(56 + bellOffset, 8, true);
-    
-    // Alert text
-    display.setTextSize(2);
-    drawCenteredText("TAKE", 26);
-    drawCenteredText("MEDICINE", 44);
+    blitLayer(frame < 2 ? SPRITE_BELL_LEFT : SPRITE_BELL_RIGHT);
+    blitLayer(SPRITE_ALERT_TEXT);
     
     // Dose time
-    display.setTextSize(1);
+    setTextSize(1);
     char timeStr[16];
     TimeManager::formatTime(doseTime, timeStr);
     drawCenteredText(timeStr, 56);
     
-    display.display();
+    flush();
 }
 
 void UIManager::displaySnooze(uint16_t remainingSeconds) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_SNOOZE).add(remainingSeconds))) return;
     
+    // Title, separator and instructions come pre-rendered from the atlas
     display.clearDisplay();
-    
-    // Title
-    display.setTextSize(1);
-    drawCenteredText("SNOOZED", 0);
-    display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
+    blitLayer(SPRITE_SNOOZE);
     
     // Remaining time
-    display.setTextSize(2);
+    setTextSize(2);
     uint8_t mins = remainingSeconds / 60;
     uint8_t secs = remainingSeconds % 60;
     char timeStr[10];
@@ -446,68 +519,67 @@ void UIManager::displaySnooze(uint16_t remainingSeconds) {
     uint8_t progress = ((SNOOZE_DURATION - remainingSeconds) * 100) / SNOOZE_DURATION;
     drawProgressBar(10, 46, SCREEN_WIDTH - 20, 8, progress);
     
-    // Instructions
-    display.setTextSize(1);
-    drawCenteredText("Open lid to take dose", 56);
-    
-    display.display();
+    flush();
 }
 
 void UIManager::displayConfirmation(const char* message, bool confirm) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_CONFIRMATION).add(message).add((uint8_t)confirm))) return;
     
     display.clearDisplay();
     
-    display.setTextSize(1);
+    setTextSize(1);
     drawCenteredText(message, 20);
     
     if (confirm) {
-        drawCenteredText("OK to confirm", 40);
-        drawCenteredText("BACK to cancel", 50);
+        drawCenteredText(TXT_HINT_CONFIRM, 40);
+        drawCenteredText(TXT_HINT_CANCEL, 50);
     }
     
-    display.display();
+    flush();
 }
 
 void UIManager::displayError(const char* message) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_ERROR).add(message))) return;
     
     display.clearDisplay();
     
-    display.setTextSize(1);
-    drawCenteredText("ERROR", 10);
+    setTextSize(1);
+    drawCenteredText(TXT_ERROR, 10);
     display.drawFastHLine(20, 20, SCREEN_WIDTH - 40, SSD1306_WHITE);
     
     drawCenteredText(message, 30);
-    drawCenteredText("Press any button", 50);
+    drawCenteredText(TXT_HINT_ANY_BUTTON, 50);
     
-    display.display();
+    flush();
 }
 
 void UIManager::displaySuccess(const char* message) {
-    if (!displayOn) return;
+    if (!beginFrame(ScreenSnapshot(SCREEN_SUCCESS).add(message))) return;
     
     display.clearDisplay();
     
-    display.setTextSize(1);
-    drawCenteredText("SUCCESS", 10);
+    setTextSize(1);
+    drawCenteredText(TXT_SUCCESS, 10);
     display.drawFastHLine(20, 20, SCREEN_WIDTH - 40, SSD1306_WHITE);
     
     drawCenteredText(message, 35);
     
-    display.display();
+    flush();
 }
 
 void UIManager::turnOff() {
+    I2CBusGuard bus(I2C_DEVICE_OLED);
     display.ssd1306_command(SSD1306_DISPLAYOFF);
     displayOn = false;
     DEBUG_PRINTLN("Display turned off");
 }
 
 void UIManager::turnOn() {
+    I2CBusGuard bus(I2C_DEVICE_OLED);
     display.ssd1306_command(SSD1306_DISPLAYON);
     displayOn = true;
     lastActivity = millis();
+    invalidate();
     DEBUG_PRINTLN("Display turned on");
 }
 
@@ -532,13 +604,320 @@ void UIManager::update() {
         animationFrame++;
         lastAnimationUpdate = millis();
     }
+    
+    // Roll the I2C traffic counter
+    if (millis() - statsWindowStart >= 1000) {
+        bytesPerSecond = bytesSentWindow;
+        bytesSentWindow = 0;
+        statsWindowStart = millis();
+    }
 }
 
 void UIManager::setBrightness(uint8_t brightness) {
+    I2CBusGuard bus(I2C_DEVICE_OLED);
     display.ssd1306_command(SSD1306_SETCONTRAST);
     display.ssd1306_command(brightness);
 }
 
+void UIManager::buildSpriteAtlas() {
+    spriteBytes = 0;
+    spriteTileCount = 0;
+    
+    // Alert: border blinks on even frames, bell swings every two frames
+    display.clearDisplay();
+    display.drawRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, SSD1306_WHITE);
+    display.drawRect(2, 2, SCREEN_WIDTH - 4, SCREEN_HEIGHT - 4, SSD1306_WHITE);
+    captureLayer(SPRITE_ALERT_BORDER);
+    
+    display.clearDisplay();
+    drawBellIcon(54, 8, true);
+    captureLayer(SPRITE_BELL_LEFT);
+    
+    display.clearDisplay();
+    drawBellIcon(58, 8, true);
+    captureLayer(SPRITE_BELL_RIGHT);
+    
+    display.clearDisplay();
+    drawCenteredText(TXT_TAKE, 26);
+    drawCenteredText(TXT_MEDICINE, 44);
+    captureLayer(SPRITE_ALERT_TEXT);
+    
+    // Snooze: everything except the countdown and progress bar
+    display.clearDisplay();
+    drawCenteredText(TXT_SNOOZED, 0);
+    display.drawFastHLine(0, 10, SCREEN_WIDTH, SSD1306_WHITE);
+    drawCenteredText(TXT_HINT_OPEN_LID, 56);
+    captureLayer(SPRITE_SNOOZE);
+    
+    display.clearDisplay();
+    DEBUG_PRINTF("Sprite atlas: %d tiles, %d bytes\n", spriteTileCount, spriteBytes);
+}
+
+void UIManager::captureLayer(SpriteLayer layer) {
+    const uint8_t* buffer = display.getBuffer();
+    layerFirstTile[layer] = spriteTileCount;
+    layerTileCount[layer] = 0;
+    
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        const uint8_t* row = buffer + page * SCREEN_WIDTH;
+        int16_t x = 0;
+        
+        while (x < SCREEN_WIDTH) {
+            if (row[x] == 0) {
+                x++;
+                continue;
+            }
+            
+            // Extend the tile over gaps too short to be worth a new one
+            int16_t last = x;
+            for (int16_t next = x + 1; next < SCREEN_WIDTH && next - last <= SPRITE_TILE_GAP; next++) {
+                if (row[next] != 0) last = next;
+            }
+            uint8_t width = last - x + 1;
+            
+            if (spriteTileCount == SPRITE_MAX_TILES || spriteBytes + width > SPRITE_ATLAS_BYTES) {
+                DEBUG_PRINTF("ERROR: Sprite atlas full at layer %d\n", layer);
+                return;
+            }
+            
+            SpriteTile& tile = spriteTiles[spriteTileCount++];
+            tile.page = page;
+            tile.x = x;
+            tile.width = width;
+            tile.offset = spriteBytes;
+            memcpy(spritePixels + spriteBytes, row + x, width);
+            spriteBytes += width;
+            layerTileCount[layer]++;
+            
+            x = last + 1;
+        }
+    }
+}
+
+void UIManager::blitLayer(SpriteLayer layer) {
+    uint8_t* buffer = display.getBuffer();
+    
+    for (uint8_t i = 0; i < layerTileCount[layer]; i++) {
+        const SpriteTile& tile = spriteTiles[layerFirstTile[layer] + i];
+        uint8_t* out = buffer + tile.page * SCREEN_WIDTH + tile.x;
+        const uint8_t* in = spritePixels + tile.offset;
+        
+        for (uint8_t column = 0; column < tile.width; column++) {
+            out[column] |= in[column];
+        }
+    }
+}
+
+bool UIManager::beginFrame(const ScreenSnapshot& snapshot) {
+    if (!displayOn) return false;
+    
+    if (snapshot == lastSnapshot) {
+        return false;  // Same content as last frame - nothing to do
+    }
+    
+    // Governor: content changed, but cap the redraw rate of the screen
+    // that is already showing. Switching screens always renders at once.
+    if (snapshot.screen == lastSnapshot.screen &&
+        millis() - lastFrameTime < frameInterval(snapshot.screen)) {
+        frameStats[snapshot.screen].deferred++;
+        return false;
+    }
+    
+    lastSnapshot = snapshot;
+    lastFrameTime = millis();
+    frameStartUs = micros();
+    return true;
+}
+
+uint16_t UIManager::frameInterval(ScreenId screen) {
+    switch (screen) {
+        case SCREEN_HOME:
+            return 1000 / FPS_IDLE;
+        case SCREEN_ALERT:
+        case SCREEN_SNOOZE:
+            return 1000 / FPS_ALERT;
+        case SCREEN_CONFIRMATION:
+        case SCREEN_ERROR:
+        case SCREEN_SUCCESS:
+            return 0;   // One-shot messages must show immediately
+        default:
+            return 1000 / FPS_MENU;
+    }
+}
+
+const char* UIManager::getScreenName(ScreenId screen) {
+    static const char* const names[SCREEN_COUNT] = {
+        "none", "home", "mainMenu", "doseMenu", "doseList", "doseEdit",
+        "timeEdit", "dateEdit", "alarmToggle", "wifiToggle", "alert",
+        "snooze", "confirmation", "error", "success"
+    };
+    return screen < SCREEN_COUNT ? names[screen] : "unknown";
+}
+
+void UIManager::printFrameStats() const {
+    DEBUG_PRINTLN("Frame stats (us): screen count render min/avg/p99 flush min/avg/p99 deferred");
+    
+    for (uint8_t i = 1; i < SCREEN_COUNT; i++) {
+        const ScreenFrameStats& s = frameStats[i];
+        if (s.render.count == 0 && s.deferred == 0) continue;
+        
+        DEBUG_PRINTF("  %-12s %5lu  %lu/%lu/%lu  %lu/%lu/%lu  %lu\n",
+                     getScreenName((ScreenId)i), s.render.count,
+                     s.render.minUs, s.render.averageUs(), s.render.percentileUs(99),
+                     s.flush.minUs, s.flush.averageUs(), s.flush.percentileUs(99),
+                     s.deferred);
+    }
+    DEBUG_PRINTF("  OLED I2C: %lu bytes/s\n", bytesPerSecond);
+}
+
+void FrameTimingStats::record(uint32_t us) {
+    if (count == 0 || us < minUs) minUs = us;
+    if (us > maxUs) maxUs = us;
+    count++;
+    totalUs += us;
+    
+    uint8_t bucket = 0;
+    while ((us >> (bucket + 1)) && bucket < FRAME_HIST_BUCKETS - 1) {
+        bucket++;
+    }
+    buckets[bucket]++;
+}
+
+uint32_t FrameTimingStats::percentileUs(uint8_t percent) const {
+    if (count == 0) return 0;
+    
+    uint32_t target = ((uint64_t)count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < FRAME_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return min((uint32_t)((2UL << i) - 1), maxUs);
+        }
+    }
+    return maxUs;
+}
+
+void UIManager::flush() {
+    ScreenId screen = lastSnapshot.screen;
+    
+    if (!displayTask) {
+        frameStats[screen].render.record(micros() - frameStartUs);
+        uint32_t start = micros();
+        transmitFrame(display.getBuffer());
+        frameStats[screen].flush.record(micros() - start);
+        return;
+    }
+    
+    // Replace any frame the task has not picked up yet
+    portENTER_CRITICAL(&frameMux);
+    memcpy(pendingFrame, display.getBuffer(), OLED_FRAME_BYTES);
+    pendingScreen = screen;
+    framePending = true;
+    portEXIT_CRITICAL(&frameMux);
+    
+    xTaskNotifyGive(displayTask);
+    frameStats[screen].render.record(micros() - frameStartUs);
+}
+
+void UIManager::displayTaskEntry(void* param) {
+    static_cast<UIManager*>(param)->runDisplayTask();
+}
+
+void UIManager::runDisplayTask() {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        bool haveFrame = false;
+        portENTER_CRITICAL(&frameMux);
+        if (framePending) {
+            uint8_t* swap = frontFrame;
+            frontFrame = pendingFrame;
+            pendingFrame = swap;
+            frontScreen = pendingScreen;
+            framePending = false;
+            haveFrame = true;
+        }
+        portEXIT_CRITICAL(&frameMux);
+        
+        if (haveFrame) {
+            uint32_t start = micros();
+            transmitFrame(frontFrame);
+            frameStats[frontScreen].flush.record(micros() - start);
+        }
+    }
+}
+
+void UIManager::transmitFrame(const uint8_t* frame) {
+    for (uint8_t page = 0; page < OLED_PAGES; page++) {
+        const uint8_t* row = frame + page * SCREEN_WIDTH;
+        uint8_t* shadow = panelShadow + page * SCREEN_WIDTH;
+        
+        if (panelShadowValid) {
+            // Find the changed column range in this page
+            int16_t first = -1;
+            int16_t last = -1;
+            for (uint8_t col = 0; col < SCREEN_WIDTH; col++) {
+                if (row[col] != shadow[col]) {
+                    if (first < 0) first = col;
+                    last = col;
+                }
+            }
+            
+            if (first < 0) continue;  // Page unchanged
+            
+            // One bus grant per page, yielded between chunks when an RTC
+            // transaction is waiting
+            I2CBusGuard bus(I2C_DEVICE_OLED);
+            sendWindow(frame, page, first, last);
+        } else {
+            I2CBusGuard bus(I2C_DEVICE_OLED);
+            sendWindow(frame, page, 0, SCREEN_WIDTH - 1);
+        }
+    }
+    
+    panelShadowValid = true;
+}
+
+void UIManager::sendWindow(const uint8_t* frame, uint8_t page, uint8_t firstCol, uint8_t lastCol) {
+    const uint8_t* row = frame + page * SCREEN_WIDTH;
+    TwoWire& wire = i2cBus.wire();
+    
+    // Address the window (horizontal addressing mode set by Adafruit_SSD1306)
+    wire.beginTransmission(OLED_ADDR);
+    wire.write((uint8_t)0x00);  // Co = 0, D/C = 0: command stream
+    wire.write((uint8_t)SSD1306_PAGEADDR);
+    wire.write(page);
+    wire.write(page);
+    wire.write((uint8_t)SSD1306_COLUMNADDR);
+    wire.write(firstCol);
+    wire.write(lastCol);
+    wire.endTransmission();
+    bytesSentWindow += 7;
+    
+    // Stream pixel data in chunks that fit the Wire buffer
+    uint8_t col = firstCol;
+    while (col <= lastCol) {
+        uint8_t chunk = min((uint16_t)OLED_I2C_CHUNK, (uint16_t)(lastCol - col + 1));
+        
+        wire.beginTransmission(OLED_ADDR);
+        wire.write((uint8_t)0x40);  // Co = 0, D/C = 1: data stream
+        wire.write(row + col, chunk);
+        wire.endTransmission();
+        bytesSentWindow += chunk + 1;
+        
+        col += chunk;
+        
+        // Let a waiting RTC transaction in between chunks. Only the OLED
+        // answers its address, so its column pointer survives the gap.
+        if (col <= lastCol && i2cBus.hasPriorityWaiter()) {
+            i2cBus.release();
+            i2cBus.acquire(I2C_DEVICE_OLED);
+        }
+    }
+    
+    memcpy(panelShadow + page * SCREEN_WIDTH + firstCol, row + firstCol, lastCol - firstCol + 1);
+}
+
 void UIManager::drawStatusBar(bool wifiOn, bool muteOn, bool alarmOn) {
     // WiFi icon
     if (wifiOn) {
@@ -552,7 +931,7 @@ void UIManager::drawStatusBar(bool wifiOn, bool muteOn, bool alarmOn) {
     
     // Alarm indicator
     if (!alarmOn) {
-        display.setTextSize(1);
+        setTextSize(1);
         display.setCursor(SCREEN_WIDTH - 28, 2);
         display.print("Zz");
     }
@@ -566,7 +945,7 @@ void UIManager::drawMenuItem(int16_t y, const char* text, bool selected) {
         display.setTextColor(SSD1306_WHITE);
     }
     
-    display.setTextSize(1);
+    setTextSize(1);
     display.setCursor(4, y);
     display.print(text);
     
@@ -583,9 +962,9 @@ void UIManager::drawTime(Time12H time, int16_t y, bool large) {
     TimeManager::formatTime(time, timeStr);
     
     if (large) {
-        display.setTextSize(2);
+        setTextSize(2);
     } else {
-        display.setTextSize(1);
+        setTextSize(1);
     }
     
     drawCenteredText(timeStr, y);
@@ -615,9 +994,21 @@ void UIManager::drawBellIcon(int16_t x, int16_t y, bool ringing) {
 }
 
 void UIManager::drawCenteredText(const char* text, int16_t y) {
-    int16_t x1, y1;
-    uint16_t w, h;
-    display.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
-    display.setCursor((SCREEN_WIDTH - w) / 2, y);
+    display.setCursor((SCREEN_WIDTH - textWidth(text)) / 2, y);
     display.print(text);
 }
+
+void UIManager::drawCenteredText(const FixedText& text, int16_t y) {
+    setTextSize(text.size);
+    display.setCursor((SCREEN_WIDTH - text.width) / 2, y);
+    display.print(text.text);
+}
+
+void UIManager::setTextSize(uint8_t size) {
+    textSize = size;
+    display.setTextSize(size);
+}
+
+int16_t UIManager::textWidth(const char* text) const {
+    return ::textWidth(text, textSize, SCREEN_WIDTH);
+}
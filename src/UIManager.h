@@ -13,11 +13,144 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
 #include "config.h"
+#include "TextMetrics.h"
 
 // Forward declarations
 class TimeManager;
 class DoseManager;
 
+/**
+ * @brief Screen identifiers used for render memoization
+ */
+enum ScreenId : uint8_t {
+    SCREEN_NONE = 0,
+    SCREEN_HOME,
+    SCREEN_MAIN_MENU,
+    SCREEN_DOSE_MENU,
+    SCREEN_DOSE_LIST,
+    SCREEN_DOSE_EDIT,
+    SCREEN_TIME_EDIT,
+    SCREEN_DATE_EDIT,
+    SCREEN_ALARM_TOGGLE,
+    SCREEN_WIFI_TOGGLE,
+    SCREEN_ALERT,
+    SCREEN_SNOOZE,
+    SCREEN_CONFIRMATION,
+    SCREEN_ERROR,
+    SCREEN_SUCCESS,
+    SCREEN_COUNT
+};
+
+// Log2 histogram buckets for frame timings: bucket n holds [2^n, 2^(n+1)) us
+#define FRAME_HIST_BUCKETS  18
+
+/**
+ * @brief Min/avg/p99 timing statistics for one stage of a screen's frames
+ */
+struct FrameTimingStats {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t buckets[FRAME_HIST_BUCKETS];
+    
+    /**
+     * @brief Record one sample
+     * @param us Duration in microseconds
+     */
+    void record(uint32_t us);
+    
+    /**
+     * @brief Average duration
+     * @return Microseconds (0 if no samples)
+     */
+    uint32_t averageUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+    
+    /**
+     * @brief Percentile estimate from the histogram
+     * @param percent Percentile (1-100)
+     * @return Upper bound of the bucket holding the percentile, in us
+     */
+    uint32_t percentileUs(uint8_t percent) const;
+};
+
+/**
+ * @brief Render and flush statistics for one screen
+ */
+struct ScreenFrameStats {
+    FrameTimingStats render;    // Composition in loop(), incl. hand-off
+    FrameTimingStats flush;     // I2C transfer in the display task
+    uint32_t deferred;          // Frames held back by the governor
+};
+
+/**
+ * @brief Compact, hashable snapshot of everything a screen shows
+ * 
+ * Each display*() call folds its inputs (selection, displayed time,
+ * dose flags, animation frame, ...) into an FNV-1a hash. If the
+ * snapshot equals the last rendered one the frame is skipped.
+ */
+struct ScreenSnapshot {
+    ScreenId screen;
+    uint32_t hash;
+    
+    explicit ScreenSnapshot(ScreenId id = SCREEN_NONE) : screen(id), hash(2166136261UL) {
+        add((uint8_t)id);
+    }
+    
+    ScreenSnapshot& add(uint8_t value) {
+        hash = (hash ^ value) * 16777619UL;
+        return *this;
+    }
+    
+    ScreenSnapshot& add(uint16_t value) {
+        return add((uint8_t)(value & 0xFF)).add((uint8_t)(value >> 8));
+    }
+    
+    ScreenSnapshot& add(Time12H time) {
+        return add(time.hour).add(time.minute).add((uint8_t)time.isPM);
+    }
+    
+    ScreenSnapshot& add(const char* text) {
+        if (text) {
+            while (*text) add((uint8_t)*text++);
+        }
+        return add((uint8_t)0);
+    }
+    
+    bool operator==(const ScreenSnapshot& other) const {
+        return screen == other.screen && hash == other.hash;
+    }
+};
+
+// Distinct alert animation images (border blink x bell swing)
+#define ALERT_SPRITE_FRAMES 4
+#define SPRITE_ATLAS_BYTES  1280    // Tile pixels of all sprite layers (about 1050 used)
+#define SPRITE_MAX_TILES    48
+#define SPRITE_TILE_GAP     4       // Blank columns bridged rather than starting a tile
+
+/**
+ * @brief Static layers of the alert and snooze screens
+ */
+enum SpriteLayer : uint8_t {
+    SPRITE_ALERT_BORDER,    // Double border, shown on even alert frames
+    SPRITE_BELL_LEFT,       // Ringing bell, swung left (frames 0-1)
+    SPRITE_BELL_RIGHT,      // Ringing bell, swung right (frames 2-3)
+    SPRITE_ALERT_TEXT,      // "TAKE MEDICINE"
+    SPRITE_SNOOZE,          // Title, separator and instructions
+    SPRITE_LAYER_COUNT
+};
+
+/**
+ * @brief Run of columns within one GDDRAM page of a sprite layer
+ */
+struct SpriteTile {
+    uint8_t page;
+    uint8_t x;
+    uint8_t width;
+    uint16_t offset;        // First byte in the atlas pixel pool
+};
+
 class UIManager {
 public:
     /**
@@ -36,7 +169,7 @@ public:
      * @param muteOn Mute status
      */
     void displayHome(Time12H time, int16_t minutesToNextDose, 
-                     uint8_t dosesTaken, uint8_t totalDoses,
+                     uint16_t dosesTaken, uint16_t totalDoses,
                      bool wifiOn, bool muteOn);
     
     /**
@@ -53,11 +186,10 @@ public:
     
     /**
      * @brief Display list of all doses
-     * @param doses Array of doses
-     * @param count Number of doses
+     * @param doses Dose table
      * @param selection Current selection index
      */
-    void displayDoseList(Dose* doses, uint8_t count, uint8_t selection);
+    void displayDoseList(const DoseTable& doses, uint16_t selection);
     
     /**
      * @brief Display dose edit screen
@@ -101,7 +233,7 @@ public:
      * @param doseNumber Dose number (1-based)
      * @param doseTime Time of the dose
      */
-    void displayAlert(uint8_t doseNumber, Time12H doseTime);
+    void displayAlert(uint16_t doseNumber, Time12H doseTime);
     
     /**
      * @brief Display snooze active screen
@@ -165,6 +297,31 @@ public:
      * @param brightness 0-255
      */
     void setBrightness(uint8_t brightness);
+    
+    /**
+     * @brief Get I2C traffic sent to the display over the last second
+     * @return Bytes per second (commands + pixel data)
+     */
+    uint32_t getBytesPerSecond() const { return bytesPerSecond; }
+    
+    /**
+     * @brief Get frame statistics for a screen
+     * @param screen Screen identifier
+     * @return Render/flush timing statistics
+     */
+    const ScreenFrameStats& getFrameStats(ScreenId screen) const { return frameStats[screen]; }
+    
+    /**
+     * @brief Get a short name for a screen (for reports)
+     * @param screen Screen identifier
+     * @return Screen name
+     */
+    static const char* getScreenName(ScreenId screen);
+    
+    /**
+     * @brief Print per-screen frame statistics to serial
+     */
+    void printFrameStats() const;
 
 private:
     Adafruit_SSD1306 display;
@@ -172,6 +329,118 @@ private:
     uint32_t lastActivity;
     uint8_t animationFrame;
     uint32_t lastAnimationUpdate;
+    uint8_t textSize;
+    ScreenSnapshot lastSnapshot;
+    
+    // Frame budget instrumentation and governor
+    ScreenFrameStats frameStats[SCREEN_COUNT];
+    uint32_t frameStartUs;
+    uint32_t lastFrameTime;
+    
+    // Copy of what the panel's GDDRAM currently holds, used to send only
+    // the page/column windows that changed since the last flush
+    uint8_t panelShadow[OLED_FRAME_BYTES];
+    bool panelShadowValid;
+    volatile uint32_t bytesSentWindow;
+    uint32_t bytesPerSecond;
+    uint32_t statsWindowStart;
+    
+    // Render pipeline: loop() composes into the Adafruit buffer and hands
+    // a copy to the pending slot; the display task swaps pending/front and
+    // streams the front frame. A newer frame overwrites a pending one.
+    uint8_t frameBuffers[2][OLED_FRAME_BYTES];
+    uint8_t* pendingFrame;
+    uint8_t* frontFrame;
+    ScreenId pendingScreen;
+    ScreenId frontScreen;
+    volatile bool framePending;
+    TaskHandle_t displayTask;
+    
+    // Pre-rendered static layers of the alert and snooze screens, kept as
+    // page-aligned column tiles and OR-ed into the frame buffer
+    uint8_t spritePixels[SPRITE_ATLAS_BYTES];
+    SpriteTile spriteTiles[SPRITE_MAX_TILES];
+    uint8_t layerFirstTile[SPRITE_LAYER_COUNT];
+    uint8_t layerTileCount[SPRITE_LAYER_COUNT];
+    uint16_t spriteBytes;
+    uint8_t spriteTileCount;
+    
+    /**
+     * @brief Render the alert/snooze sprite atlas (once, at startup)
+     */
+    void buildSpriteAtlas();
+    
+    /**
+     * @brief Store the GFX buffer's lit columns as the tiles of a layer
+     * @param layer Layer just drawn into a cleared buffer
+     */
+    void captureLayer(SpriteLayer layer);
+    
+    /**
+     * @brief OR a layer's tiles into the GFX buffer
+     * @param layer Layer to draw
+     */
+    void blitLayer(SpriteLayer layer);
+    
+    /**
+     * @brief Decide whether a screen needs to be rendered
+     * @param snapshot Snapshot of the screen about to be drawn
+     * @return true if the caller should render, false if unchanged
+     */
+    bool beginFrame(const ScreenSnapshot& snapshot);
+    
+    /**
+     * @brief Minimum time between redraws of a screen
+     * @param screen Screen identifier
+     * @return Interval in ms (0 = uncapped)
+     */
+    static uint16_t frameInterval(ScreenId screen);
+    
+    /**
+     * @brief Forget the last rendered snapshot (forces next render)
+     */
+    void invalidate() { lastSnapshot = ScreenSnapshot(); }
+    
+    /**
+     * @brief Draw the shared hour/minute/AM-PM editor
+     * @param title Screen title
+     * @param time Time being edited
+     * @param editField 0=hour, 1=minute, 2=AM/PM
+     */
+    void drawTimeEditor(const FixedText& title, Time12H time, uint8_t editField);
+    
+    /**
+     * @brief Hand the composed frame to the display task
+     */
+    void flush();
+    
+    /**
+     * @brief Display task entry point
+     * @param param UIManager instance
+     */
+    static void displayTaskEntry(void* param);
+    
+    /**
+     * @brief Display task body: wait for frames and stream them
+     */
+    void runDisplayTask();
+    
+    /**
+     * @brief Push changed regions of a frame to the panel
+     * @param frame Frame to transmit (SSD1306 page layout)
+     */
+    void transmitFrame(const uint8_t* frame);
+    
+    /**
+     * @brief Send one column window of a page to the panel
+     * @param frame Frame holding the pixel data
+     * @param page GDDRAM page (0-7)
+     * @param firstCol First column of the window
+     * @param lastCol Last column of the window (inclusive)
+     * @note The caller holds the bus; it is released and re-acquired
+     *       between chunks while a high-priority transaction waits
+     */
+    void sendWindow(const uint8_t* frame, uint8_t page, uint8_t firstCol, uint8_t lastCol);
     
     /**
      * @brief Draw status bar with icons
@@ -228,6 +497,26 @@ private:
      * @param y Y position
      */
     void drawCenteredText(const char* text, int16_t y);
+    
+    /**
+     * @brief Center a fixed string using its precomputed width
+     * @param text Fixed string (also sets its text size)
+     * @param y Y position
+     */
+    void drawCenteredText(const FixedText& text, int16_t y);
+    
+    /**
+     * @brief Set text size and remember it for width calculations
+     * @param size GFX text size multiplier
+     */
+    void setTextSize(uint8_t size);
+    
+    /**
+     * @brief Pixel width of text at the current size
+     * @param text Text to measure
+     * @return Width in pixels (widest line)
+     */
+    int16_t textWidth(const char* text) const;
 };
 
 #endif // UI_MANAGER_H
@@ -0,0 +1,44 @@
+/**
+ * @file WakeSchedule.cpp
+ * @brief Deep sleep wake time implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "WakeSchedule.h"
+
+uint32_t nextWakeTime(uint32_t now, const DoseTable& doses, const SystemState& state) {
+    uint32_t midnight = now - (now % 86400UL);
+    MinuteOfDay nowMinutes = (now % 86400UL) / 60;
+    uint32_t wake = 0;
+    bool anyEnabled = false;
+    
+    // Earliest dose still pending today (the table is sorted)
+    for (uint16_t i = 0; i < doses.count; i++) {
+        if (!(doses.flags[i] & DOSE_FLAG_ENABLED)) continue;
+        anyEnabled = true;
+        
+        if (doses.minutes[i] <= nowMinutes) continue;
+        if (doses.flags[i] & DOSE_FLAG_TAKEN) continue;
+        
+        wake = midnight + doses.minutes[i] * 60UL;
+        break;
+    }
+    
+    // Nothing left today: wake at midnight so the daily reset runs,
+    // then the next sleep targets tomorrow's first dose
+    if (wake == 0 && anyEnabled) {
+        wake = midnight + 86400UL;
+    }
+    
+    if (state.snoozeActive && (wake == 0 || state.snoozeUntil < wake)) {
+        wake = state.snoozeUntil;
+    }
+    
+    // Never program a time the RTC has already passed
+    if (wake != 0 && wake <= now) {
+        wake = now + 1;
+    }
+    
+    return wake;
+}
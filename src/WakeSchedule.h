@@ -0,0 +1,25 @@
+/**
+ * @file WakeSchedule.h
+ * @brief When the RTC should wake the device from deep sleep
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef WAKE_SCHEDULE_H
+#define WAKE_SCHEDULE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+/**
+ * @brief Work out when the RTC should next wake the device
+ * @param now Current Unix time
+ * @param doses Dose schedule, including today's taken flags
+ * @param state System state (snooze)
+ * @return Unix time to wake at, or 0 if only a user wake is needed
+ * @note Depends only on config.h so the battery-life simulation in
+ *       test/ runs the same policy on a host
+ */
+uint32_t nextWakeTime(uint32_t now, const DoseTable& doses, const SystemState& state);
+
+#endif // WAKE_SCHEDULE_H
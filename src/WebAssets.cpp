@@ -0,0 +1,73 @@
+/**
+ * @file WebAssets.cpp
+ * @brief Pre-gzipped web UI file serving implementation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include "WebAssets.h"
+
+uint8_t WebAssets::begin() {
+    count = 0;
+    
+    File manifest = SPIFFS.open(WEB_ASSET_MANIFEST, "r");
+    if (!manifest) {
+        DEBUG_PRINTLN("WARNING: No web asset manifest, serving files as stored");
+        return 0;
+    }
+    
+    // One "<path> <etag>" line per file
+    while (manifest.available() && count < WEB_MAX_ASSETS) {
+        String line = manifest.readStringUntil('\n');
+        char hash[17];
+        
+        if (sscanf(line.c_str(), "%23s %16s", assets[count].path, hash) == 2) {
+            snprintf(assets[count].etag, sizeof(assets[count].etag), "\"%s\"", hash);
+            count++;
+        }
+    }
+    manifest.close();
+    
+    DEBUG_PRINTF("Web assets: %d listed\n", count);
+    return count;
+}
+
+bool WebAssets::canHandle(AsyncWebServerRequest* request) {
+    if (request->method() != HTTP_GET || !find(request->url())) {
+        return false;
+    }
+    
+    // Headers not asked for are dropped before the handler runs
+    request->addInterestingHeader("If-None-Match");
+    return true;
+}
+
+void WebAssets::handleRequest(AsyncWebServerRequest* request) {
+    const WebAsset* asset = find(request->url());
+    AsyncWebServerResponse* response;
+    
+    if (request->hasHeader("If-None-Match") &&
+        request->getHeader("If-None-Match")->value() == asset->etag) {
+        response = request->beginResponse(304);
+    } else {
+        // Only <path>.gz is in the image: the response sends it with
+        // Content-Encoding: gzip and the type of <path>
+        response = request->beginResponse(SPIFFS, asset->path);
+    }
+    
+    response->addHeader("ETag", asset->etag);
+    response->addHeader("Cache-Control", WEB_CACHE_CONTROL);
+    request->send(response);
+}
+
+const WebAsset* WebAssets::find(const String& url) const {
+    const char* path = (url == "/") ? "/index.html" : url.c_str();
+    
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(assets[i].path, path) == 0) {
+            return &assets[i];
+        }
+    }
+    
+    return nullptr;
+}
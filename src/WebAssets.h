@@ -0,0 +1,67 @@
+/**
+ * @file WebAssets.h
+ * @brief Pre-gzipped web UI files with ETag revalidation
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <SPIFFS.h>
+#include "config.h"
+
+/**
+ * @brief One file listed in the asset manifest
+ */
+struct WebAsset {
+    char path[24];          // Request path, e.g. "/index.html"
+    char etag[20];          // Quoted content hash
+};
+
+/**
+ * @brief Serves the files built by tools/build_web.py
+ *
+ * The build gzips each file in web/ into the filesystem image and lists
+ * it with a hash of its bytes in WEB_ASSET_MANIFEST. Responses carry
+ * Content-Encoding: gzip, the hash as a strong ETag and
+ * WEB_CACHE_CONTROL; a request whose If-None-Match matches gets a 304
+ * from RAM without opening the file. Paths not in the manifest fall
+ * through to the next handler.
+ */
+class WebAssets : public AsyncWebHandler {
+public:
+    /**
+     * @brief Read the manifest (SPIFFS must be mounted)
+     * @return Number of assets listed
+     */
+    uint8_t begin();
+    
+    /**
+     * @brief Check if a request is for a listed asset
+     * @param request Incoming request
+     * @return true if this handler serves it
+     */
+    bool canHandle(AsyncWebServerRequest* request) override;
+    
+    /**
+     * @brief Send the asset, or 304 if the client's copy is current
+     * @param request Request accepted by canHandle()
+     */
+    void handleRequest(AsyncWebServerRequest* request) override;
+
+private:
+    WebAsset assets[WEB_MAX_ASSETS];
+    uint8_t count;
+    
+    /**
+     * @brief Find the asset for a request path ("/" is the index page)
+     * @param url Request path
+     * @return Asset, or nullptr if not listed
+     */
+    const WebAsset* find(const String& url) const;
+};
+
+#endif // WEB_ASSETS_H
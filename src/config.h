@@ -18,12 +18,31 @@
 #define OLED_ADDR           0x3C
 #define SCREEN_WIDTH        128
 #define SCREEN_HEIGHT       64
+#define OLED_PAGES          (SCREEN_HEIGHT / 8)     // 8-pixel rows per GDDRAM page
+#define OLED_I2C_CHUNK      64      // Max data bytes per I2C transaction
+#define OLED_FRAME_BYTES    (SCREEN_WIDTH * OLED_PAGES)
+
+// Background display task (streams frames to the OLED off the main loop)
+#define DISPLAY_TASK_CORE       0       // Arduino loop() runs on core 1
+#define DISPLAY_TASK_STACK      3072
+#define DISPLAY_TASK_PRIORITY   1
+
+// Frame-rate governor: max redraws per second per screen type
+#define FPS_IDLE                2       // Home screen
+#define FPS_MENU                10      // Menus, edit and toggle screens
+#define FPS_ALERT               8       // Alert and snooze screens
+#define FRAME_STATS_INTERVAL    60000   // Print frame statistics (ms)
 
 // ============================================================================
 // RTC CONFIGURATION (I2C - shares same bus as OLED)
 // ============================================================================
 #define RTC_SDA             21
 #define RTC_SCL             22
+#define RTC_INT_PIN         4       // DS3231 INT/SQW (open drain, Active LOW)
+
+// Shared bus clock: DS3231 is rated for 400 kHz fast mode, so the OLED
+// runs at the same speed
+#define I2C_BUS_CLOCK       400000
 
 // ============================================================================
 // BUTTON CONFIGURATION (Active LOW with internal pull-up)
@@ -35,7 +54,7 @@
 // ============================================================================
 // SENSOR CONFIGURATION
 // ============================================================================
-#define REED_SWITCH         32      // Lid magnetic sensor (Active LOW)
+#define REED_SWITCH         32      // Lid magnetic sensor (HIGH when open, pull-up)
 
 // ============================================================================
 // BUZZER CONFIGURATION
@@ -54,12 +73,22 @@
 #define LID_DEBOUNCE_DURATION   500     // Lid must be open for 500ms
 #define TIME_CHECK_INTERVAL     1000    // Check time every 1 second (ms)
 #define ALARM_CHECK_TOLERANCE   5       // ±5 seconds tolerance for alarm
+#define RTC_RESYNC_INTERVAL     3600000 // Re-read RTC over I2C every hour (ms)
+#define RTC_SQW_TIMEOUT         2500    // No 1 Hz tick for this long = poll RTC (ms)
 
 // ============================================================================
 // DOSE CONFIGURATION
 // ============================================================================
-#define MAX_DOSES               10      // Maximum doses per day
-#define MIN_DOSE_SPACING        15      // Minimum minutes between doses
+#define MAX_DOSES               512     // Maximum doses per day (all compartments)
+#define MAX_COMPARTMENTS        16      // Compartment ids 0-15 (4 bits in storage)
+#define MIN_DOSE_SPACING        15      // Minimum minutes between doses in a compartment
+
+// ============================================================================
+// POWER CONFIGURATION
+// ============================================================================
+#define POWER_SLEEP_ENABLED     1       // Deep sleep between dose events
+#define SLEEP_IDLE_DELAY        10000   // Idle time after screen off before sleeping (ms)
+#define SLEEP_WAKE_ON_LID       0       // 1 = lid opening wakes instead of OK button (a snoozed alarm arms both)
 
 // ============================================================================
 // WIFI CONFIGURATION
@@ -69,13 +98,32 @@
 #define WIFI_AP_CHANNEL         1
 #define WIFI_MAX_CONNECTIONS    4
 #define WEB_SERVER_PORT         80
+#define WEB_MAX_BODY_SIZE       32768   // Largest accepted POST body (bulk dose upload)
+#define WEB_LOG_PAGE            100     // Default log records per /api/logs response
+#define WEB_LOG_BATCH           32      // Log records read per chunk of a streamed reply
+#define WEB_EVENT_INTERVAL      50      // State checked for /api/events pushes this often (ms)
+#define WEB_ASSET_MANIFEST      "/etags.txt"    // Written by tools/build_web.py
+#define WEB_MAX_ASSETS          4       // Web UI files read from the manifest
+#define WEB_CACHE_CONTROL       "no-cache"      // Cache, but revalidate by ETag on each load
 
 // ============================================================================
 // STORAGE CONFIGURATION
 // ============================================================================
 #define STORAGE_NAMESPACE       "pillbox"
-#define STORAGE_VERSION         1
-#define MAX_LOG_ENTRIES         100     // Maximum lid opening logs
+#define STORAGE_VERSION         5
+#define DOSE_RECORD_SIZE        3       // Minute of day (2 bytes LE) + flags
+#define DOSE_BLOCK_RECORDS      16      // Dose records per CRC-32 in the stored schedule
+#define MAX_LOG_ENTRIES         100     // Lid opening log keys in v3 and earlier NVS
+#define SAVE_QUIET_PERIOD       2000    // Write the schedule once edits pause this long (ms)
+#define SAVE_MAX_DELAY          10000   // Longest a changed schedule waits to be written (ms)
+#define SETTINGS_SAVE_DELAY     3000    // Settings toggles within this window make one write (ms)
+
+// Event log: ring of flash segments in its own partition (see partitions.csv)
+#define EVENT_LOG_PARTITION     "eventlog"
+#define EVENT_LOG_SEGMENT_SIZE  4096    // One flash erase sector per segment
+#define EVENT_LOG_MAX_SEGMENTS  64      // Largest partition used (256 KB)
+#define EVENT_LOG_BATCH         16      // Records buffered in RAM per flash write
+#define EVENT_LOG_FLUSH_DELAY   5000    // Write buffered records after this long (ms)
 
 // ============================================================================
 // DEBUG CONFIGURATION
@@ -104,10 +152,10 @@ struct Time12H {
     bool isPM;          // false = AM, true = PM
     
     // Default constructor
-    Time12H() : hour(12), minute(0), isPM(false) {}
+    constexpr Time12H() : hour(12), minute(0), isPM(false) {}
     
     // Parameterized constructor
-    Time12H(uint8_t h, uint8_t m, bool pm) : hour(h), minute(m), isPM(pm) {}
+    constexpr Time12H(uint8_t h, uint8_t m, bool pm) : hour(h), minute(m), isPM(pm) {}
     
     // Comparison operators
     bool operator==(const Time12H& other) const {
@@ -120,15 +168,75 @@ struct Time12H {
 };
 
 /**
- * @brief Dose schedule structure
+ * @brief Time of day as minutes since midnight (0-1439)
+ * 
+ * Canonical representation for doses, RTC memory and storage. Time12H is
+ * only used to present times on the OLED and in the web JSON.
  */
-struct Dose {
-    Time12H time;
-    bool enabled;
-    bool taken;         // Reset daily at midnight
-    uint8_t id;
-    
-    Dose() : enabled(false), taken(false), id(0) {}
+typedef uint16_t MinuteOfDay;
+
+#define MINUTES_PER_DAY     1440
+
+/**
+ * @brief Build a minute of day from 24-hour clock fields
+ */
+constexpr MinuteOfDay toMinuteOfDay(uint8_t hour24, uint8_t minute) {
+    return hour24 * 60 + minute;
+}
+
+/**
+ * @brief Convert a 12-hour time to minutes since midnight
+ */
+constexpr MinuteOfDay toMinuteOfDay(Time12H time) {
+    return toMinuteOfDay((time.hour % 12) + (time.isPM ? 12 : 0), time.minute);
+}
+
+/**
+ * @brief Convert minutes since midnight to a 12-hour time
+ */
+constexpr Time12H toTime12H(MinuteOfDay minutes) {
+    return Time12H((minutes / 60) % 12 == 0 ? 12 : (minutes / 60) % 12,
+                   minutes % 60,
+                   minutes >= 12 * 60);
+}
+
+/**
+ * @brief Minutes from one time of day forward to another (wraps at midnight)
+ * @return 0-1439, 0 if the times are equal
+ */
+constexpr uint16_t minutesForward(MinuteOfDay from, MinuteOfDay to) {
+    return (to + MINUTES_PER_DAY - from) % MINUTES_PER_DAY;
+}
+
+/**
+ * @brief Shortest distance between two times of day in either direction
+ * @return 0-720
+ */
+constexpr uint16_t minutesApart(MinuteOfDay a, MinuteOfDay b) {
+    return minutesForward(a, b) < minutesForward(b, a) ? minutesForward(a, b)
+                                                       : minutesForward(b, a);
+}
+
+static_assert(toMinuteOfDay(Time12H(12, 0, false)) == 0, "12 AM is midnight");
+static_assert(toMinuteOfDay(Time12H(12, 30, true)) == 750, "12 PM is noon");
+static_assert(toTime12H(1439).hour == 11 && toTime12H(1439).isPM, "23:59 is 11 PM");
+
+// Dose flag bits
+#define DOSE_FLAG_ENABLED   0x01
+#define DOSE_FLAG_TAKEN     0x02    // Reset daily at midnight
+
+/**
+ * @brief Dose schedule, struct-of-arrays sorted by time
+ * 
+ * Minutes are kept in their own contiguous array so the due check and
+ * next-dose search only touch 2 bytes per dose. Plain data with no
+ * constructor so it can live in RTC memory across deep sleep.
+ */
+struct DoseTable {
+    MinuteOfDay minutes[MAX_DOSES];     // Ascending
+    uint8_t flags[MAX_DOSES];           // DOSE_FLAG_*
+    uint8_t compartments[MAX_DOSES];    // 0 to MAX_COMPARTMENTS-1
+    uint16_t count;
 };
 
 /**
@@ -170,10 +278,8 @@ struct SystemState {
     uint32_t snoozeUntil;       // Unix timestamp
     MenuState currentMenu;
     uint8_t menuSelection;
-    uint8_t editIndex;
-    Dose doses[MAX_DOSES];
-    uint8_t doseCount;
-    int8_t activeDoseIndex;     // Currently alerting dose (-1 if none)
+    uint16_t editIndex;
+    int16_t activeDoseIndex;    // Currently alerting dose (-1 if none)
     uint32_t lastActivity;
     uint8_t currentDay;         // For midnight reset detection
     
@@ -188,7 +294,6 @@ struct SystemState {
         currentMenu(MENU_HOME),
         menuSelection(0),
         editIndex(0),
-        doseCount(0),
         activeDoseIndex(-1),
         lastActivity(0),
         currentDay(0) {}
@@ -17,6 +17,7 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <esp_system.h>
 
 // Project modules
 #include "config.h"
@@ -28,6 +29,8 @@
 #include "LidSensor.h"
 #include "PillBoxWebServer.h"
 #include "Storage.h"
+#include "I2CBus.h"
+#include "PowerManager.h"
 
 // ============================================================================
 // GLOBAL OBJECTS
@@ -40,6 +43,7 @@ AlarmController alarmController;
 LidSensor lidSensor;
 PillBoxWebServer webServer;
 Storage storage;
+PowerManager powerManager;
 
 // System state
 SystemState systemState;
@@ -52,7 +56,7 @@ uint16_t editYear;
 
 // Timing variables
 uint32_t lastTimeCheck = 0;
-uint32_t lastDisplayUpdate = 0;
+uint32_t lastStatsReport = 0;
 
 // ============================================================================
 // FUNCTION DECLARATIONS
@@ -69,18 +73,26 @@ void handleAlarmToggle();
 void handleWiFiToggle();
 void handleAlertState();
 void checkDoseTime();
+void takeActiveDose();
 void checkMidnightReset();
 void updateDisplay();
 void handleButtonsInMenu();
 void goToHome();
 void saveSystemState();
+void restoreAfterWake();
+bool isSystemBusy();
+void enterSleep();
+void flushOnShutdown();
 
 // ============================================================================
 // SETUP
 // ============================================================================
 void setup() {
     Serial.begin(115200);
-    delay(1000);
+    powerManager.begin();
+    if (!powerManager.wokeFromSleep()) {
+        delay(1000);
+    }
     
     DEBUG_PRINTLN("\n========================================");
     DEBUG_PRINTLN("  Smart Pill Box - Starting Up");
@@ -90,8 +102,8 @@ void setup() {
 }
 
 void initializeSystem() {
-    // Initialize I2C
-    Wire.begin(OLED_SDA, OLED_SCL);
+    // Initialize the shared I2C bus (OLED + RTC)
+    i2cBus.begin(OLED_SDA, OLED_SCL, I2C_BUS_CLOCK);
     
     // Initialize storage first to load saved settings
     if (!storage.begin()) {
@@ -126,15 +138,13 @@ void initializeSystem() {
     
     // Initialize dose manager and load saved doses
     doseManager.begin();
-    Dose loadedDoses[MAX_DOSES];
-    uint8_t loadedCount = storage.loadDoses(loadedDoses);
-    for (uint8_t i = 0; i < loadedCount; i++) {
-        doseManager.addDose(loadedDoses[i].time);
-        if (!loadedDoses[i].enabled) {
-            doseManager.setDoseEnabled(i, false);
-        }
+    if (!powerManager.restoreState(doseManager, systemState)) {
+        doseManager.loadFromStorage(storage, timeManager.getDayNumber());
     }
     
+    // Pending schedule, settings and log writes are made before any esp_restart()
+    esp_register_shutdown_handler(flushOnShutdown);
+    
     // Initialize other components
     buttonHandler.begin();
     alarmController.begin();
@@ -142,7 +152,14 @@ void initializeSystem() {
     lidSensor.begin();
     
     // Initialize web server (but don't start it yet)
-    webServer.begin(&timeManager, &doseManager, &alarmController, &storage);
+    webServer.begin(&timeManager, &doseManager, &alarmController, &storage, &uiManager, &lidSensor);
+    
+    if (powerManager.wokeFromSleep()) {
+        // Short path: no splash or startup sound after deep sleep
+        restoreAfterWake();
+        DEBUG_PRINTLN("Resumed from deep sleep");
+        return;
+    }
     
     // Load last known day for midnight detection
     systemState.currentDay = storage.loadLastDay();
@@ -183,28 +200,24 @@ void loop() {
     // Periodically check for dose time
     if (millis() - lastTimeCheck >= TIME_CHECK_INTERVAL) {
         lastTimeCheck = millis();
+        checkMidnightReset();  // First, so a new day's doses are not seen as taken
         checkDoseTime();
-        checkMidnightReset();
     }
     
+    // Write-behind: save the schedule once edits have settled, and
+    // settings and buffered log entries once they are due
+    doseManager.update(storage);
+    storage.update();
+    
     // Handle lid opening during alarm
     if (systemState.alarmActive && lidSensor.justOpened()) {
         DEBUG_PRINTLN("Lid opened during alarm - marking dose taken");
-        
-        if (systemState.activeDoseIndex >= 0) {
-            doseManager.markDoseTaken(systemState.activeDoseIndex);
-            storage.logLidOpening(timeManager.getUnixTime(), 
-                                  systemState.activeDoseIndex, true);
-        }
-        
-        alarmController.stopAlarm();
-        alarmController.playConfirm();
-        systemState.alarmActive = false;
-        systemState.snoozeActive = false;
-        systemState.activeDoseIndex = -1;
-        systemState.currentMenu = MENU_HOME;
+        takeActiveDose();
     }
     
+    // Push what changed to connected browsers
+    webServer.update();
+    
     // Handle current menu state
     switch (systemState.currentMenu) {
         case MENU_HOME:
@@ -256,6 +269,21 @@ void loop() {
     if (!systemState.alarmActive && uiManager.checkTimeout()) {
         systemState.currentMenu = MENU_HOME;
     }
+    
+    // Deep sleep until the next dose once nothing needs the CPU
+    powerManager.update(isSystemBusy());
+    if (powerManager.shouldSleep()) {
+        enterSleep();
+    }
+    
+#if DEBUG_ENABLED
+    // Periodic rendering and bus usage report
+    if (millis() - lastStatsReport >= FRAME_STATS_INTERVAL) {
+        lastStatsReport = millis();
+        uiManager.printFrameStats();
+        i2cBus.printStats();
+    }
+#endif
 }
 
 // ============================================================================
@@ -265,16 +293,13 @@ void loop() {
 void handleHomeScreen() {
     // Get current data
     Time12H currentTime = timeManager.getCurrentTime();
-    int16_t minutesToNext = doseManager.getMinutesUntilNextDose(timeManager);
-    uint8_t takenCount = doseManager.getDosesTakenCount();
-    uint8_t totalCount = doseManager.getEnabledDosesCount();
+    int16_t minutesToNext = doseManager.getMinutesUntilNextDose(timeManager.getMinuteOfDay());
+    uint16_t takenCount = doseManager.getDosesTakenCount();
+    uint16_t totalCount = doseManager.getEnabledDosesCount();
     
-    // Update display
-    if (millis() - lastDisplayUpdate >= 1000) {
-        lastDisplayUpdate = millis();
-        uiManager.displayHome(currentTime, minutesToNext, takenCount, totalCount,
-                             systemState.wifiEnabled, systemState.muteMode);
-    }
+    // Update display (UIManager skips unchanged frames and caps the rate)
+    uiManager.displayHome(currentTime, minutesToNext, takenCount, totalCount,
+                         systemState.wifiEnabled, systemState.muteMode);
     
     // Handle OK button - go to menu
     ButtonEvent okEvent = buttonHandler.getOkEvent();
@@ -416,14 +441,12 @@ void handleDoseMenu() {
 
 void handleDoseList() {
     // Display dose list for selection (delete mode)
-    uiManager.displayDoseList(doseManager.getDoses(), doseManager.getDoseCount(), 
-                              systemState.editIndex);
+    uiManager.displayDoseList(doseManager.getTable(), systemState.editIndex);
     
     ButtonEvent okEvent = buttonHandler.getOkEvent();
     if (okEvent == BTN_SHORT_PRESS) {
         // Delete selected dose
         if (doseManager.removeDose(systemState.editIndex)) {
-            doseManager.saveToStorage(storage);
             alarmController.playConfirm();
         }
         
@@ -459,14 +482,12 @@ void handleDoseEdit(bool isNew) {
         static bool inListMode = true;
         
         if (inListMode) {
-            uiManager.displayDoseList(doseManager.getDoses(), doseManager.getDoseCount(),
-                                     systemState.editIndex);
+            uiManager.displayDoseList(doseManager.getTable(), systemState.editIndex);
             
             ButtonEvent okEvent = buttonHandler.getOkEvent();
             if (okEvent == BTN_SHORT_PRESS) {
-                Dose* selectedDose = doseManager.getDose(systemState.editIndex);
-                if (selectedDose) {
-                    editingTime = selectedDose->time;
+                if (systemState.editIndex < doseManager.getDoseCount()) {
+                    editingTime = toTime12H(doseManager.getDoseTime(systemState.editIndex));
                     editField = 0;
                     inListMode = false;
                 }
@@ -495,8 +516,7 @@ void handleDoseEdit(bool isNew) {
         if (editField > 2) {
             // Save the dose
             if (isNew) {
-                if (doseManager.addDose(editingTime)) {
-                    doseManager.saveToStorage(storage);
+                if (doseManager.addDose(toMinuteOfDay(editingTime))) {
                     alarmController.playConfirm();
                     systemState.currentMenu = MENU_EDIT_DOSES;
                     systemState.menuSelection = 0;
@@ -506,8 +526,7 @@ void handleDoseEdit(bool isNew) {
                     delay(1500);
                 }
             } else {
-                if (doseManager.updateDose(systemState.editIndex, editingTime)) {
-                    doseManager.saveToStorage(storage);
+                if (doseManager.updateDose(systemState.editIndex, toMinuteOfDay(editingTime))) {
                     alarmController.playConfirm();
                     systemState.currentMenu = MENU_EDIT_DOSES;
                     systemState.menuSelection = 1;
@@ -696,8 +715,6 @@ void handleWiFiToggle() {
 }
 
 void handleAlertState() {
-    Dose* activeDose = doseManager.getDose(systemState.activeDoseIndex);
-    
     if (systemState.snoozeActive) {
         uint16_t remaining = alarmController.getSnoozeRemaining();
         uiManager.displaySnooze(remaining);
@@ -705,8 +722,10 @@ void handleAlertState() {
         if (remaining == 0) {
             systemState.snoozeActive = false;
         }
-    } else if (activeDose) {
-        uiManager.displayAlert(systemState.activeDoseIndex + 1, activeDose->time);
+    } else if (systemState.activeDoseIndex >= 0 &&
+               systemState.activeDoseIndex < doseManager.getDoseCount()) {
+        uiManager.displayAlert(systemState.activeDoseIndex + 1,
+                               toTime12H(doseManager.getDoseTime(systemState.activeDoseIndex)));
     }
     
     // BACK button - snooze
@@ -743,8 +762,7 @@ void checkDoseTime() {
         return;
     }
     
-    Time12H currentTime = timeManager.getCurrentTime();
-    int8_t doseIndex = doseManager.checkDoseTime(currentTime);
+    int16_t doseIndex = doseManager.checkDoseTime(timeManager.getMinuteOfDay());
     
     if (doseIndex >= 0) {
         DEBUG_PRINTF("Dose %d is due!\n", doseIndex);
@@ -763,10 +781,13 @@ void checkMidnightReset() {
     uint16_t year;
     timeManager.getDate(day, month, year);
     
-    if (day != systemState.currentDay && systemState.currentDay != 0) {
-        DEBUG_PRINTLN("New day detected - resetting dose status");
-        doseManager.resetDailyStatus();
-        lidSensor.resetDailyCount();
+    if (day != systemState.currentDay) {
+        if (systemState.currentDay != 0) {
+            DEBUG_PRINTLN("New day detected - resetting dose status");
+            doseManager.resetDailyStatus(timeManager.getDayNumber());
+            lidSensor.resetDailyCount();
+        }
+        // Also on first boot, so a restart knows which day it is
         storage.saveLastDay(day);
     }
     
@@ -781,5 +802,88 @@ void goToHome() {
 
 void saveSystemState() {
     storage.saveSettings(systemState.alarmEnabled, systemState.muteMode);
-    doseManager.saveToStorage(storage);
+    storage.flush();
+    doseManager.flush(storage);
+}
+
+void takeActiveDose() {
+    if (systemState.activeDoseIndex >= 0) {
+        doseManager.markDoseTaken(systemState.activeDoseIndex);
+        storage.logLidOpening(timeManager.getUnixTime(), 
+                              systemState.activeDoseIndex, true);
+    }
+    
+    alarmController.stopAlarm();
+    alarmController.playConfirm();
+    systemState.alarmActive = false;
+    systemState.snoozeActive = false;
+    systemState.activeDoseIndex = -1;
+    systemState.currentMenu = MENU_HOME;
+}
+
+void restoreAfterWake() {
+    systemState.lastActivity = millis();
+    
+    if (systemState.alarmActive && lidSensor.isOpen()) {
+        // The device only sleeps with the lid shut, so it was opened during
+        // the snooze (and woke us, or is found open at the snooze's end)
+        DEBUG_PRINTLN("Lid opened while asleep - marking dose taken");
+        takeActiveDose();
+        uiManager.turnOn();
+    } else if (systemState.alarmActive) {
+        // Resume the alert; the snooze continues if it has not run out
+        uint32_t now = timeManager.getUnixTime();
+        alarmController.startAlarm(PATTERN_STANDARD);
+        if (systemState.snoozeActive && systemState.snoozeUntil > now) {
+            alarmController.snooze(systemState.snoozeUntil - now);
+        } else {
+            systemState.snoozeActive = false;
+        }
+        systemState.currentMenu = MENU_ALERT;
+        uiManager.turnOn();
+    } else if (powerManager.getWakeReason() == WAKE_RTC_ALARM) {
+        // Dose check turns the screen on if this wake is for a dose
+        systemState.currentMenu = MENU_HOME;
+        uiManager.turnOff();
+    } else {
+        systemState.currentMenu = MENU_HOME;
+    }
+    
+    // Check the schedule on the first pass through loop()
+    lastTimeCheck = millis() - TIME_CHECK_INTERVAL;
+}
+
+bool isSystemBusy() {
+    if (buttonHandler.anyButtonPressed()) {
+        return true;
+    }
+    
+    // The web server and an open lid keep the device awake
+    if (systemState.wifiEnabled || lidSensor.isOpen()) {
+        return true;
+    }
+    
+    // A snoozed alarm may sleep until the snooze ends, with the lid armed
+    // as a wake source; a sounding one may not
+    if (systemState.snoozeActive) {
+        return false;
+    }
+    return systemState.alarmActive || uiManager.isOn();
+}
+
+void enterSleep() {
+    if (systemState.snoozeActive) {
+        systemState.snoozeUntil = timeManager.getUnixTime() +
+                                  alarmController.getSnoozeRemaining();
+    }
+    
+    alarmController.stopAlarm();
+    doseManager.flush(storage);
+    storage.flush();
+    powerManager.enterSleep(timeManager, doseManager, uiManager, systemState);
+}
+
+void flushOnShutdown() {
+    doseManager.flush(storage);
+    storage.flush();
 }
@@ -0,0 +1,45 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the parts of the Arduino core the tested modules use
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+// Milliseconds since boot; tests move it forward themselves
+inline uint32_t fakeMillis = 0;
+
+inline uint32_t millis() { return fakeMillis; }
+inline uint32_t micros() { return fakeMillis * 1000UL; }
+inline void delay(uint32_t ms) { fakeMillis += ms; }
+
+/**
+ * @brief Serial that discards everything (keeps DEBUG_PRINT quiet)
+ */
+struct FakeSerial {
+    template <typename T> size_t print(const T&) { return 0; }
+    template <typename T> size_t println(const T&) { return 0; }
+    size_t println() { return 0; }
+    size_t printf(const char*, ...) { return 0; }
+    void flush() {}
+};
+
+inline FakeSerial Serial;
+
+#endif // FAKE_ARDUINO_H
@@ -0,0 +1,127 @@
+/**
+ * @file Preferences.h
+ * @brief Host stand-in for the ESP32 Preferences (NVS) library
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * Keys live in one shared map so a test can build an NVS image before
+ * Storage::begin() and inspect it afterwards. Every get and put is
+ * counted, and a power cut can be scheduled after a number of writes.
+ * A hook can run code in the middle of the next write, as another task
+ * would while the loop is blocked in NVS.
+ */
+
+#ifndef FAKE_PREFERENCES_H
+#define FAKE_PREFERENCES_H
+
+#include <Arduino.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Thrown by the write that loses power; nothing of that write is stored
+struct PowerCut {};
+
+struct FakeNvs {
+    std::map<std::string, std::vector<uint8_t>> keys;  // "namespace/key"
+    uint32_t reads = 0;
+    uint32_t writes = 0;                // Puts, removes and clears
+    int32_t writesUntilPowerCut = -1;   // -1 = never
+    std::function<void()> duringNextWrite;
+    
+    void reset() { *this = FakeNvs(); }
+    
+    void countWrite() {
+        if (writesUntilPowerCut == 0) {
+            writesUntilPowerCut = -1;
+            throw PowerCut();
+        }
+        if (writesUntilPowerCut > 0) writesUntilPowerCut--;
+        writes++;
+        if (duringNextWrite) {
+            std::function<void()> hook = duringNextWrite;
+            duringNextWrite = nullptr;
+            hook();
+        }
+    }
+};
+
+inline FakeNvs fakeNvs;
+
+class Preferences {
+public:
+    bool begin(const char* name, bool = false) {
+        prefix = std::string(name) + "/";
+        return true;
+    }
+    void end() {}
+    
+    bool clear() {
+        fakeNvs.countWrite();
+        auto it = fakeNvs.keys.lower_bound(prefix);
+        while (it != fakeNvs.keys.end() && it->first.compare(0, prefix.size(), prefix) == 0) {
+            it = fakeNvs.keys.erase(it);
+        }
+        return true;
+    }
+    bool remove(const char* key) {
+        fakeNvs.countWrite();
+        return fakeNvs.keys.erase(prefix + key) > 0;
+    }
+    bool isKey(const char* key) {
+        fakeNvs.reads++;
+        return fakeNvs.keys.count(prefix + key) > 0;
+    }
+    size_t freeEntries() { return 500 - fakeNvs.keys.size(); }
+    
+    size_t putUChar(const char* key, uint8_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUShort(const char* key, uint16_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putULong(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+    size_t putBytes(const char* key, const void* value, size_t length) { return put(key, value, length); }
+    
+    uint8_t getUChar(const char* key, uint8_t value = 0) { get(key, &value, sizeof(value)); return value; }
+    uint16_t getUShort(const char* key, uint16_t value = 0) { get(key, &value, sizeof(value)); return value; }
+    uint32_t getUInt(const char* key, uint32_t value = 0) { get(key, &value, sizeof(value)); return value; }
+    uint32_t getULong(const char* key, uint32_t value = 0) { get(key, &value, sizeof(value)); return value; }
+    bool getBool(const char* key, bool value = false) { return getUChar(key, value ? 1 : 0) != 0; }
+    
+    size_t getBytes(const char* key, void* buffer, size_t maxLength) {
+        const std::vector<uint8_t>* stored = find(key);
+        if (!stored || stored->size() > maxLength) return 0;
+        memcpy(buffer, stored->data(), stored->size());
+        return stored->size();
+    }
+    size_t getBytesLength(const char* key) {
+        const std::vector<uint8_t>* stored = find(key);
+        return stored ? stored->size() : 0;
+    }
+
+private:
+    std::string prefix;
+    
+    size_t put(const char* key, const void* value, size_t length) {
+        fakeNvs.countWrite();
+        const uint8_t* bytes = (const uint8_t*)value;
+        fakeNvs.keys[prefix + key].assign(bytes, bytes + length);
+        return length;
+    }
+    
+    // Typed gets leave the default in place when the key is missing
+    void get(const char* key, void* value, size_t length) {
+        const std::vector<uint8_t>* stored = find(key);
+        if (stored && stored->size() == length) {
+            memcpy(value, stored->data(), length);
+        }
+    }
+    
+    const std::vector<uint8_t>* find(const char* key) {
+        fakeNvs.reads++;
+        auto it = fakeNvs.keys.find(prefix + key);
+        return it == fakeNvs.keys.end() ? nullptr : &it->second;
+    }
+};
+
+#endif // FAKE_PREFERENCES_H
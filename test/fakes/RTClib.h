@@ -0,0 +1,13 @@
+/**
+ * @file RTClib.h
+ * @brief Host stand-in for RTClib: only what TimeManager.h declares
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef FAKE_RTCLIB_H
+#define FAKE_RTCLIB_H
+
+class RTC_DS3231 {};
+
+#endif // FAKE_RTCLIB_H
@@ -0,0 +1,97 @@
+/**
+ * @file esp_partition.h
+ * @brief Host stand-in for the ESP-IDF partition API: one data partition in RAM
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * Behaves like NOR flash: erase sets bytes to 0xFF and a write can only
+ * clear bits, so a rewrite without an erase shows up as corrupt data.
+ */
+
+#ifndef FAKE_ESP_PARTITION_H
+#define FAKE_ESP_PARTITION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK                  0
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_SIZE    0x104
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    uint8_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+#define FAKE_SECTOR_SIZE    4096
+
+struct FakeFlash {
+    esp_partition_t partition = {ESP_PARTITION_TYPE_DATA, 0x40, 0x3B0000, 0x40000, "eventlog"};
+    std::vector<uint8_t> bytes = std::vector<uint8_t>(0x40000, 0xFF);
+    bool present = true;
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+    uint32_t erases = 0;
+    
+    // Blank partition of the given size
+    void reset(uint32_t size = 0x40000) {
+        *this = FakeFlash();
+        partition.size = size;
+        bytes.assign(size, 0xFF);
+    }
+};
+
+inline FakeFlash fakeFlash;
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type,
+                                                       esp_partition_subtype_t,
+                                                       const char* label) {
+    if (!fakeFlash.present || type != fakeFlash.partition.type) return nullptr;
+    if (label && strcmp(label, fakeFlash.partition.label) != 0) return nullptr;
+    return &fakeFlash.partition;
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset,
+                                    void* buffer, size_t size) {
+    if (offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(buffer, &fakeFlash.bytes[offset], size);
+    fakeFlash.reads++;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset,
+                                     const void* buffer, size_t size) {
+    if (offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    const uint8_t* data = (const uint8_t*)buffer;
+    for (size_t i = 0; i < size; i++) {
+        fakeFlash.bytes[offset + i] &= data[i];
+    }
+    fakeFlash.writes++;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset,
+                                           size_t size) {
+    if (offset % FAKE_SECTOR_SIZE || size % FAKE_SECTOR_SIZE) return ESP_ERR_INVALID_ARG;
+    if (offset + size > partition->size) return ESP_ERR_INVALID_SIZE;
+    memset(&fakeFlash.bytes[offset], 0xFF, size);
+    fakeFlash.erases++;
+    return ESP_OK;
+}
+
+#endif // FAKE_ESP_PARTITION_H
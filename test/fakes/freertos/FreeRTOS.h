@@ -0,0 +1,22 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS types the tested modules use
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef FAKE_FREERTOS_H
+#define FAKE_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE             0
+#define pdTRUE              1
+#define portMAX_DELAY       0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms)   (ms)
+
+#endif // FAKE_FREERTOS_H
@@ -0,0 +1,28 @@
+/**
+ * @file semphr.h
+ * @brief Host stand-in for FreeRTOS mutexes (tests run on one thread)
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef FAKE_SEMPHR_H
+#define FAKE_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef struct FakeMutex { int held; }* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return new FakeMutex{0}; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t) {
+    if (mutex->held) return pdFALSE;    // Would deadlock on the device
+    mutex->held = 1;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    mutex->held = 0;
+    return pdTRUE;
+}
+
+#endif // FAKE_SEMPHR_H
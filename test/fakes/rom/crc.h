@@ -0,0 +1,39 @@
+/**
+ * @file crc.h
+ * @brief Host stand-in for the ESP32 ROM CRC-32 (IEEE 802.3, reflected)
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#ifndef FAKE_ROM_CRC_H
+#define FAKE_ROM_CRC_H
+
+#include <stdint.h>
+
+/**
+ * @brief Same result as the ROM crc32_le(): pass 0 to start, or the
+ *        previous result to continue over more data
+ */
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    // Table-driven like the ROM routine, so host timings are comparable
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    value = (value >> 1) ^ ((value & 1) ? 0xEDB88320UL : 0);
+                }
+                entries[i] = value;
+            }
+        }
+    } table;
+    
+    crc = ~crc;
+    while (len--) {
+        crc = (crc >> 8) ^ table.entries[(crc ^ *buf++) & 0xFF];
+    }
+    return ~crc;
+}
+
+#endif // FAKE_ROM_CRC_H
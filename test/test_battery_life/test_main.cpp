@@ -0,0 +1,211 @@
+/**
+ * @file test_main.cpp
+ * @brief Battery-life simulation of deep sleep against the always-on loop
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * Steps through four weeks of RTC wakes chosen by the firmware's own
+ * nextWakeTime() and charges each awake period with the currents below.
+ * The currents are typical datasheet figures, not measurements on the
+ * board; change them here to re-run with measured values.
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include "WakeSchedule.h"
+
+// Assumed currents (mA, 3.3 V rail)
+#define ESP32_ACTIVE_MA     50.0    // 240 MHz, radio off
+#define ESP32_SLEEP_MA      0.010   // Deep sleep, RTC timer and memory on
+#define DS3231_MA           0.110   // Timekeeping, I2C idle
+#define OLED_ON_MA          15.0    // SSD1306, about a third of the pixels lit
+#define OLED_OFF_MA         0.010   // SSD1306 display off (sleep)
+#define BUZZER_MA           30.0    // While the alert pattern plays
+#define DEVKIT_MA           5.0     // DevKit regulator and power LED, always drawn
+
+// Assumed usage
+#define BATTERY_MAH         2000.0
+#define BOOT_SECONDS        0.5     // Wake to the first loop() pass
+#define RESPONSE_SECONDS    60      // Alarm sounding before the lid is opened
+#define SNOOZE_SECONDS      20      // Alarm sounding before BACK is pressed
+#define LID_OPEN_SECONDS    10      // Lid open while the pills are taken
+#define CHECKS_PER_DAY      3       // OK presses just to look at the screen
+
+#define SIM_START           1700006400UL    // A midnight
+#define SIM_DAYS            28
+
+struct Scenario {
+    const char* name;
+    MinuteOfDay minutes[24];
+    uint8_t count;
+    bool snoozeFirst;       // Every alarm is snoozed once before it is taken
+};
+
+static const Scenario scenarios[] = {
+    {"1 dose/day", {toMinuteOfDay(8, 0)}, 1, false},
+    {"3 doses/day", {toMinuteOfDay(8, 0), toMinuteOfDay(14, 0), toMinuteOfDay(20, 0)}, 3, false},
+    {"3 doses/day, snoozed", {toMinuteOfDay(8, 0), toMinuteOfDay(14, 0), toMinuteOfDay(20, 0)}, 3, true},
+    {"6 doses/day", {toMinuteOfDay(6, 0), toMinuteOfDay(9, 0), toMinuteOfDay(12, 0),
+                     toMinuteOfDay(15, 0), toMinuteOfDay(18, 0), toMinuteOfDay(21, 0)}, 6, false},
+    {"24 doses/day", {60, 120, 180, 240, 300, 360, 420, 480, 540, 600, 660, 720, 780, 840,
+                      900, 960, 1020, 1080, 1140, 1200, 1260, 1320, 1380, 1430}, 24, false},
+};
+
+// Seconds spent in each power state over the simulated period
+struct Tally {
+    double awake;
+    double screen;
+    double buzzer;
+    uint32_t wakes;
+    uint32_t alarms;
+};
+
+static void awakeFor(Tally& tally, double seconds, bool screen, bool buzzer) {
+    tally.awake += seconds;
+    if (screen) tally.screen += seconds;
+    if (buzzer) tally.buzzer += seconds;
+}
+
+/**
+ * @brief Alarm sounding, lid opened, then the screen timeout and idle delay
+ */
+static void takeDose(Tally& tally) {
+    awakeFor(tally, RESPONSE_SECONDS, true, true);
+    awakeFor(tally, LID_OPEN_SECONDS, true, false);
+    awakeFor(tally, SCREEN_TIMEOUT / 1000.0, true, false);
+    awakeFor(tally, SLEEP_IDLE_DELAY / 1000.0, false, false);
+    tally.alarms++;
+}
+
+static Tally simulate(const Scenario& scenario) {
+    DoseTable doses = {};
+    for (uint8_t i = 0; i < scenario.count; i++) {
+        doses.minutes[i] = scenario.minutes[i];
+        doses.flags[i] = DOSE_FLAG_ENABLED;
+    }
+    doses.count = scenario.count;
+    
+    SystemState state;
+    Tally tally = {};
+    int16_t snoozedDose = -1;
+    uint32_t now = SIM_START + 1;
+    const uint32_t end = SIM_START + SIM_DAYS * 86400UL;
+    
+    while (true) {
+        uint32_t wake = nextWakeTime(now, doses, state);
+        TEST_ASSERT_TRUE(wake > now);
+        if (wake >= end) break;
+        
+        now = wake;
+        tally.wakes++;
+        awakeFor(tally, BOOT_SECONDS, false, false);
+        double awakeBefore = tally.awake;
+        
+        if (state.snoozeActive && now >= state.snoozeUntil) {
+            // Snooze over: the alert resumes and this time the lid is opened
+            state.snoozeActive = false;
+            doses.flags[snoozedDose] |= DOSE_FLAG_TAKEN;
+            takeDose(tally);
+        } else if (now % 86400UL == 0) {
+            // Midnight: daily reset with the screen off
+            for (uint16_t i = 0; i < doses.count; i++) {
+                doses.flags[i] &= ~DOSE_FLAG_TAKEN;
+            }
+            awakeFor(tally, SLEEP_IDLE_DELAY / 1000.0, false, false);
+        } else {
+            MinuteOfDay minute = (now % 86400UL) / 60;
+            int16_t due = -1;
+            for (uint16_t i = 0; i < doses.count; i++) {
+                if (doses.minutes[i] == minute && !(doses.flags[i] & DOSE_FLAG_TAKEN)) {
+                    due = i;
+                    break;
+                }
+            }
+            TEST_ASSERT_TRUE_MESSAGE(due >= 0, "woken with no dose due");
+            
+            if (scenario.snoozeFirst) {
+                // Snoozed: sleeps after the idle delay, alert still pending
+                awakeFor(tally, SNOOZE_SECONDS, true, true);
+                state.snoozeActive = true;
+                state.snoozeUntil = now + SNOOZE_SECONDS + SNOOZE_DURATION;
+                snoozedDose = due;
+                awakeFor(tally, SLEEP_IDLE_DELAY / 1000.0, true, false);
+            } else {
+                doses.flags[due] |= DOSE_FLAG_TAKEN;
+                takeDose(tally);
+            }
+        }
+        
+        now += (uint32_t)(tally.awake - awakeBefore + 0.5);
+    }
+    
+    // Button wakes just to check the time
+    for (uint32_t i = 0; i < CHECKS_PER_DAY * SIM_DAYS; i++) {
+        awakeFor(tally, BOOT_SECONDS, false, false);
+        awakeFor(tally, SCREEN_TIMEOUT / 1000.0, true, false);
+        awakeFor(tally, SLEEP_IDLE_DELAY / 1000.0, false, false);
+    }
+    
+    return tally;
+}
+
+/**
+ * @brief Average current over the period (mA)
+ * @param awakeSeconds Time the ESP32 runs; the rest is deep sleep
+ */
+static double averageCurrent(const Tally& tally, double awakeSeconds, double boardMa) {
+    const double period = SIM_DAYS * 86400.0;
+    double charge = ESP32_ACTIVE_MA * awakeSeconds
+                  + ESP32_SLEEP_MA * (period - awakeSeconds)
+                  + OLED_ON_MA * tally.screen
+                  + OLED_OFF_MA * (period - tally.screen)
+                  + BUZZER_MA * tally.buzzer
+                  + (DS3231_MA + boardMa) * period;
+    return charge / period;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_every_dose_alarms_once_a_day() {
+    for (const Scenario& scenario : scenarios) {
+        Tally tally = simulate(scenario);
+        
+        TEST_ASSERT_EQUAL_UINT32(scenario.count * SIM_DAYS, tally.alarms);
+        
+        // One wake per dose (two if snoozed) and one per midnight, bar the
+        // midnight that ends the run
+        uint32_t perDay = scenario.count * (scenario.snoozeFirst ? 2 : 1) + 1;
+        TEST_ASSERT_EQUAL_UINT32(perDay * SIM_DAYS - 1, tally.wakes);
+    }
+}
+
+void test_battery_life() {
+    for (const Scenario& scenario : scenarios) {
+        Tally tally = simulate(scenario);
+        const double period = SIM_DAYS * 86400.0;
+        
+        double sleeping = averageCurrent(tally, tally.awake, 0);
+        double alwaysOn = averageCurrent(tally, period, 0);
+        double devkit = averageCurrent(tally, tally.awake, DEVKIT_MA);
+        
+        char message[160];
+        snprintf(message, sizeof(message),
+                 "%-21s awake %4.1f%%: %.3f mA, %5.0f days | always on %.1f mA, %.1f days | devkit %.1f days",
+                 scenario.name, 100.0 * tally.awake / period,
+                 sleeping, BATTERY_MAH / sleeping / 24.0,
+                 alwaysOn, BATTERY_MAH / alwaysOn / 24.0,
+                 BATTERY_MAH / devkit / 24.0);
+        TEST_MESSAGE(message);
+        
+        // Sleeping between events must beat the always-on loop by far
+        TEST_ASSERT_TRUE(sleeping * 5 < alwaysOn);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_dose_alarms_once_a_day);
+    RUN_TEST(test_battery_life);
+    return UNITY_END();
+}
@@ -0,0 +1,139 @@
+/**
+ * @file test_main.cpp
+ * @brief Old bitwise CRC-8 against CRC-32 (crc32_le): throughput and missed corruptions
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include <rom/crc.h>
+#include "config.h"
+
+#define BENCH_BYTES         (4UL << 20)     // Checked per size and algorithm
+#define CORRUPTION_TRIALS   200000
+
+/**
+ * @brief The old Storage::calculateCRC(), also the PBL2 block check
+ */
+__attribute__((noinline))
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            if (crc & 0x80) {
+                crc = (crc << 1) ^ 0x07;
+            } else {
+                crc <<= 1;
+            }
+        }
+    }
+    
+    return crc;
+}
+
+struct Buffer {
+    const char* name;
+    size_t length;
+};
+
+// What gets checked: one stored dose block, one full log block, and
+// the whole schedule the old code checked in one go
+static const Buffer buffers[] = {
+    {"dose block", DOSE_BLOCK_RECORDS * DOSE_RECORD_SIZE},
+    {"log block", EVENT_LOG_BATCH * 4},
+    {"full schedule", MAX_DOSES * DOSE_RECORD_SIZE},
+};
+
+static std::vector<uint8_t> randomBytes(size_t length, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::vector<uint8_t> bytes(length);
+    for (uint8_t& byte : bytes) byte = random();
+    return bytes;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_crc32_matches_reference() {
+    // CRC-32/ISO-HDLC check value, and continuing over a split input
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32_le(0, check, 9));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32_le(crc32_le(0, check, 4), check + 4, 5));
+}
+
+void test_throughput() {
+    for (const Buffer& buffer : buffers) {
+        std::vector<uint8_t> data = randomBytes(buffer.length, buffer.length);
+        size_t runs = BENCH_BYTES / buffer.length;
+        volatile uint32_t sink = 0;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (size_t run = 0; run < runs; run++) {
+            data[0] = run;
+            sink += crc8(data.data(), data.size());
+        }
+        auto crc8At = std::chrono::steady_clock::now();
+        for (size_t run = 0; run < runs; run++) {
+            data[0] = run;
+            sink += crc32_le(0, data.data(), data.size());
+        }
+        auto crc32At = std::chrono::steady_clock::now();
+        
+        double crc8Ns = std::chrono::duration<double, std::nano>(crc8At - start).count() / runs;
+        double crc32Ns = std::chrono::duration<double, std::nano>(crc32At - crc8At).count() / runs;
+        
+        char message[128];
+        snprintf(message, sizeof(message),
+                 "host, %-13s %4u bytes: CRC-8 %7.1f ns (%4.0f MB/s), CRC-32 %6.1f ns (%4.0f MB/s)",
+                 buffer.name, (unsigned)buffer.length, crc8Ns, buffer.length * 1000.0 / crc8Ns,
+                 crc32Ns, buffer.length * 1000.0 / crc32Ns);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_TRUE(sink != 0);
+    }
+}
+
+void test_missed_corruptions() {
+    // Random damage to a dose block: 2 to 16 bytes overwritten anywhere
+    const size_t length = DOSE_BLOCK_RECORDS * DOSE_RECORD_SIZE;
+    std::vector<uint8_t> data = randomBytes(length, 1);
+    uint8_t goodCrc8 = crc8(data.data(), length);
+    uint32_t goodCrc32 = crc32_le(0, data.data(), length);
+    
+    std::mt19937 random(2);
+    uint32_t missed8 = 0;
+    uint32_t missed32 = 0;
+    for (uint32_t trial = 0; trial < CORRUPTION_TRIALS; trial++) {
+        std::vector<uint8_t> damaged = data;
+        uint8_t bytes = 2 + random() % 15;
+        for (uint8_t i = 0; i < bytes; i++) {
+            damaged[random() % length] = random();
+        }
+        if (damaged == data) continue;
+        
+        missed8 += crc8(damaged.data(), length) == goodCrc8;
+        missed32 += crc32_le(0, damaged.data(), length) == goodCrc32;
+    }
+    
+    char message[96];
+    snprintf(message, sizeof(message), "%u corrupted blocks: CRC-8 missed %u, CRC-32 missed %u",
+             CORRUPTION_TRIALS, missed8, missed32);
+    TEST_MESSAGE(message);
+    
+    // About 1 in 256 slips past CRC-8
+    TEST_ASSERT_GREATER_THAN(CORRUPTION_TRIALS / 512, missed8);
+    TEST_ASSERT_EQUAL_UINT32(0, missed32);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_matches_reference);
+    RUN_TEST(test_throughput);
+    RUN_TEST(test_missed_corruptions);
+    return UNITY_END();
+}
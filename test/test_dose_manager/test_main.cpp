@@ -0,0 +1,329 @@
+/**
+ * @file test_main.cpp
+ * @brief DoseManager table at 10, 100 and 500 doses against the old array of structs
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+#include "DoseManager.h"
+#include "Storage.h"
+
+#define BENCH_RUNS      20
+
+static const uint16_t sizes[] = {10, 100, 500, MAX_DOSES};
+
+static DoseManager doseManager;
+
+/**
+ * @brief Dose layout before the struct-of-arrays table, with the id
+ *        widened so it can count past 255
+ */
+struct OldDose {
+    MinuteOfDay time;
+    bool enabled;
+    bool taken;
+    uint16_t id;
+};
+
+/**
+ * @brief The old DoseManager::sortDoses(): bubble sort, then renumber
+ */
+static void oldSort(OldDose* doses, uint16_t count) {
+    for (uint16_t i = 0; i + 1 < count; i++) {
+        for (uint16_t j = 0; j < count - i - 1; j++) {
+            if (doses[j].time > doses[j + 1].time) {
+                OldDose temp = doses[j];
+                doses[j] = doses[j + 1];
+                doses[j + 1] = temp;
+            }
+        }
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        doses[i].id = i;
+    }
+}
+
+/**
+ * @brief The old DoseManager::checkDoseTime(): scan every dose
+ */
+__attribute__((noinline))
+static int16_t oldCheckDoseTime(const OldDose* doses, uint16_t count, MinuteOfDay currentTime) {
+    for (uint16_t i = 0; i < count; i++) {
+        if (doses[i].enabled && !doses[i].taken && doses[i].time == currentTime) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief A valid schedule of count doses in random order: one dose a
+ *        minute, compartments taking turns so each keeps its spacing
+ *        (MAX_COMPARTMENTS >= MIN_DOSE_SPACING)
+ */
+static std::vector<MinuteOfDay> shuffledSchedule(uint16_t count, std::vector<uint8_t>& compartments) {
+    std::vector<uint16_t> order(count);
+    for (uint16_t i = 0; i < count; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(count));
+    
+    std::vector<MinuteOfDay> minutes(count);
+    compartments.resize(count);
+    for (uint16_t i = 0; i < count; i++) {
+        uint16_t k = order[i];
+        minutes[i] = k;
+        compartments[i] = k % MAX_COMPARTMENTS;
+    }
+    return minutes;
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - since).count();
+}
+
+void setUp() {
+    doseManager.begin();
+}
+
+void tearDown() {}
+
+void test_adds_keep_table_sorted() {
+    std::vector<uint8_t> compartments;
+    std::vector<MinuteOfDay> minutes = shuffledSchedule(MAX_DOSES, compartments);
+    
+    for (uint16_t i = 0; i < MAX_DOSES; i++) {
+        TEST_ASSERT_TRUE(doseManager.addDose(minutes[i], compartments[i]));
+    }
+    TEST_ASSERT_FALSE(doseManager.addDose(MINUTES_PER_DAY - 1, 0));
+    
+    const DoseTable& table = doseManager.getTable();
+    TEST_ASSERT_EQUAL_UINT16(MAX_DOSES, table.count);
+    for (uint16_t i = 1; i < table.count; i++) {
+        TEST_ASSERT_TRUE(table.minutes[i - 1] <= table.minutes[i]);
+    }
+    
+    // Every dose is due at its own minute and nowhere else
+    for (uint16_t i = 0; i < table.count; i++) {
+        int16_t due = doseManager.checkDoseTime(table.minutes[i]);
+        TEST_ASSERT_TRUE(due >= 0);
+        TEST_ASSERT_EQUAL_UINT16(table.minutes[i], table.minutes[due]);
+    }
+    TEST_ASSERT_EQUAL_INT16(-1, doseManager.checkDoseTime(MINUTES_PER_DAY - 1));
+}
+
+void test_next_dose_ignores_taken_disabled_doses() {
+    doseManager.addDose(toMinuteOfDay(8, 0));
+    doseManager.addDose(toMinuteOfDay(9, 0));
+    
+    // Taken, then disabled: must not hide the dose still pending
+    doseManager.markDoseTaken(0);
+    doseManager.setDoseEnabled(0, false);
+    TEST_ASSERT_EQUAL_INT16(1, doseManager.getNextDose(toMinuteOfDay(7, 0)));
+    
+    doseManager.markDoseTaken(1);
+    TEST_ASSERT_EQUAL_INT16(-1, doseManager.getNextDose(toMinuteOfDay(7, 0)));
+    
+    doseManager.resetDailyStatus(1);
+    TEST_ASSERT_EQUAL_INT16(1, doseManager.getNextDose(toMinuteOfDay(7, 0)));
+    doseManager.setDoseEnabled(0, true);
+    TEST_ASSERT_EQUAL_INT16(0, doseManager.getNextDose(toMinuteOfDay(7, 0)));
+}
+
+void test_uncached_search_matches_cursor() {
+    for (uint8_t hour = 6; hour < 22; hour += 2) {
+        doseManager.addDose(toMinuteOfDay(hour, 30));
+    }
+    doseManager.markDoseTaken(2);
+    doseManager.setDoseEnabled(5, false);
+    
+    for (MinuteOfDay minute = 0; minute < MINUTES_PER_DAY; minute++) {
+        TEST_ASSERT_EQUAL_INT16(doseManager.getNextDose(minute), doseManager.findNextDose(minute));
+    }
+}
+
+void test_same_minute_doses_keep_taken_across_replace() {
+    // Added out of compartment order: stored as compartment 1, then 3
+    doseManager.addDose(toMinuteOfDay(8, 0), 3);
+    doseManager.addDose(toMinuteOfDay(8, 0), 1);
+    const DoseTable& table = doseManager.getTable();
+    TEST_ASSERT_EQUAL_UINT8(1, table.compartments[0]);
+    TEST_ASSERT_EQUAL_UINT8(3, table.compartments[1]);
+    
+    doseManager.markDoseTaken(0);
+    
+    // Replace with the same schedule: compartment 1 is still taken
+    DoseBatchError errors[2];
+    doseManager.beginReplace();
+    doseManager.stageDose(0, toMinuteOfDay(8, 0), 3);
+    doseManager.stageDose(1, toMinuteOfDay(8, 0), 1);
+    TEST_ASSERT_EQUAL_UINT16(0, doseManager.commitReplace(errors));
+    
+    const DoseTable& replaced = doseManager.getTable();
+    TEST_ASSERT_EQUAL_UINT8(1, replaced.compartments[0]);
+    TEST_ASSERT_TRUE(doseManager.isDoseTaken(0));
+    TEST_ASSERT_FALSE(doseManager.isDoseTaken(1));
+    TEST_ASSERT_EQUAL_UINT16(1, doseManager.getDosesTakenCount());
+}
+
+void test_change_during_save_is_not_lost() {
+    static Storage storage;
+    fakeNvs.reset();
+    fakeFlash.reset();
+    storage.begin();
+    
+    // The web server adds a dose while the loop is writing the schedule
+    doseManager.addDose(toMinuteOfDay(8, 0));
+    fakeNvs.duringNextWrite = [] {
+        TEST_ASSERT_TRUE(doseManager.addDose(toMinuteOfDay(20, 0)));
+    };
+    doseManager.flush(storage);
+    TEST_ASSERT_TRUE(fakeNvs.duringNextWrite == nullptr);     // The hook ran
+    TEST_ASSERT_TRUE(doseManager.hasUnsavedChanges());
+    
+    doseManager.flush(storage);
+    TEST_ASSERT_FALSE(doseManager.hasUnsavedChanges());
+    doseManager.begin();
+    doseManager.loadFromStorage(storage, 0);
+    TEST_ASSERT_EQUAL_UINT16(2, doseManager.getDoseCount());
+}
+
+void test_sort() {
+    for (uint16_t count : sizes) {
+        std::vector<uint8_t> compartments;
+        std::vector<MinuteOfDay> minutes = shuffledSchedule(count, compartments);
+        
+        DoseTable shuffled = {};
+        std::vector<OldDose> oldShuffled(count);
+        for (uint16_t i = 0; i < count; i++) {
+            shuffled.minutes[i] = minutes[i];
+            shuffled.compartments[i] = compartments[i];
+            shuffled.flags[i] = DOSE_FLAG_ENABLED;
+            oldShuffled[i] = {minutes[i], true, false, i};
+        }
+        shuffled.count = count;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            std::vector<OldDose> doses = oldShuffled;
+            oldSort(doses.data(), count);
+        }
+        double oldUs = elapsedUs(start) / BENCH_RUNS;
+        
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            doseManager.loadTable(shuffled, 0);
+        }
+        double newUs = elapsedUs(start) / BENCH_RUNS;
+        
+        char message[96];
+        snprintf(message, sizeof(message), "host, %3u doses: sort bubble %8.2f us, std::sort %6.2f us",
+                 count, oldUs, newUs);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_EQUAL_UINT16(count, doseManager.getDoseCount());
+    }
+}
+
+void test_insert_and_remove() {
+    for (uint16_t count : sizes) {
+        std::vector<uint8_t> compartments;
+        std::vector<MinuteOfDay> minutes = shuffledSchedule(count, compartments);
+        
+        // Old add: append, then bubble sort the whole array
+        auto start = std::chrono::steady_clock::now();
+        std::vector<OldDose> doses;
+        doses.reserve(count);
+        for (uint16_t i = 0; i < count; i++) {
+            doses.push_back({minutes[i], true, false, i});
+            oldSort(doses.data(), doses.size());
+        }
+        double oldInsertUs = elapsedUs(start) / count;
+        
+        // addDose() also checks spacing and formats its log line
+        start = std::chrono::steady_clock::now();
+        for (uint16_t i = 0; i < count; i++) {
+            doseManager.addDose(minutes[i], compartments[i]);
+        }
+        double newInsertUs = elapsedUs(start) / count;
+        TEST_ASSERT_EQUAL_UINT16(count, doseManager.getDoseCount());
+        
+        // Remove from the front, the worst case for both
+        start = std::chrono::steady_clock::now();
+        while (!doses.empty()) {
+            for (size_t i = 0; i + 1 < doses.size(); i++) {
+                doses[i] = doses[i + 1];
+                doses[i].id = i;
+            }
+            doses.pop_back();
+        }
+        double oldRemoveUs = elapsedUs(start) / count;
+        
+        start = std::chrono::steady_clock::now();
+        while (doseManager.getDoseCount() > 0) {
+            doseManager.removeDose(0);
+        }
+        double newRemoveUs = elapsedUs(start) / count;
+        
+        char message[128];
+        snprintf(message, sizeof(message),
+                 "host, %3u doses: insert %7.2f -> %5.3f us, remove %5.3f -> %5.3f us",
+                 count, oldInsertUs, newInsertUs, oldRemoveUs, newRemoveUs);
+        TEST_MESSAGE(message);
+    }
+}
+
+void test_due_check() {
+    for (uint16_t count : sizes) {
+        std::vector<uint8_t> compartments;
+        std::vector<MinuteOfDay> minutes = shuffledSchedule(count, compartments);
+        
+        std::vector<OldDose> doses(count);
+        for (uint16_t i = 0; i < count; i++) {
+            doses[i] = {minutes[i], true, false, i};
+            doseManager.addDose(minutes[i], compartments[i]);
+        }
+        oldSort(doses.data(), count);
+        
+        // One check per minute of the day, as the 1 Hz loop sees them
+        volatile int32_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            for (MinuteOfDay minute = 0; minute < MINUTES_PER_DAY; minute++) {
+                sink += oldCheckDoseTime(doses.data(), count, minute);
+            }
+        }
+        double oldNs = elapsedUs(start) * 1000.0 / (BENCH_RUNS * MINUTES_PER_DAY);
+        
+        int32_t found = 0;
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            for (MinuteOfDay minute = 0; minute < MINUTES_PER_DAY; minute++) {
+                found += doseManager.checkDoseTime(minute) >= 0;
+            }
+        }
+        double newNs = elapsedUs(start) * 1000.0 / (BENCH_RUNS * MINUTES_PER_DAY);
+        
+        char message[96];
+        snprintf(message, sizeof(message), "host, %3u doses: due check scan %7.1f ns, binary search %5.1f ns",
+                 count, oldNs, newNs);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_EQUAL_INT32(count * BENCH_RUNS, found);
+        TEST_ASSERT_TRUE(sink != 0);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_adds_keep_table_sorted);
+    RUN_TEST(test_next_dose_ignores_taken_disabled_doses);
+    RUN_TEST(test_uncached_search_matches_cursor);
+    RUN_TEST(test_same_minute_doses_keep_taken_across_replace);
+    RUN_TEST(test_change_during_save_is_not_lost);
+    RUN_TEST(test_sort);
+    RUN_TEST(test_insert_and_remove);
+    RUN_TEST(test_due_check);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+/**
+ * @file test_main.cpp
+ * @brief EventLog reading segments in the old PBL2 format next to current ones
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include <unity.h>
+#include <vector>
+#include "EventLog.h"
+
+// PBL2 layout as EventLog.cpp reads it: XOR-checked header, then blocks
+// of payload length, CRC-8 and HistoryCodec records
+#define PBL2_MAGIC          0x50424C32
+#define PBL2_BLOCK_HEADER   2
+
+#define LOG_START           1700000000U
+
+static EventLog eventLog;
+
+static uint8_t crc8(const uint8_t* data, size_t length) {
+    uint8_t crc = 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    
+    return crc;
+}
+
+/**
+ * @brief Write a PBL2 segment 0 holding one record a second from
+ *        LOG_START, in blocks of the given record counts
+ * @return Bytes of the segment used
+ */
+static size_t writeLegacySegment(const std::vector<uint8_t>& blockRecords) {
+    uint8_t* segment = &fakeFlash.bytes[0];
+    uint32_t header[6] = {PBL2_MAGIC, 0, 0, 0, LOG_START, 0};
+    for (uint8_t i = 0; i < 5; i++) {
+        header[5] ^= header[i];
+    }
+    header[5] = ~header[5];
+    memcpy(segment, header, sizeof(header));
+    
+    size_t offset = EVENT_LOG_HEADER_SIZE;
+    uint32_t timestamp = LOG_START;
+    for (uint8_t records : blockRecords) {
+        uint8_t* payload = segment + offset + PBL2_BLOCK_HEADER;
+        size_t length = 0;
+        for (uint8_t i = 0; i < records; i++) {
+            LogEntry entry = {timestamp + 1, (uint16_t)(i % 4), true};
+            length += historyEncode(entry, timestamp, payload + length);
+            timestamp = entry.timestamp;
+        }
+        segment[offset] = length;
+        segment[offset + 1] = crc8(payload, length);
+        offset += PBL2_BLOCK_HEADER + length;
+    }
+    return offset;
+}
+
+/**
+ * @brief Read the whole log in pages, checking one record a second
+ * @return Records read
+ */
+static uint32_t readAll() {
+    LogEntry page[64];
+    uint32_t id = 0;
+    uint32_t total = 0;
+    uint16_t count;
+    
+    while ((count = eventLog.read(id, page, 64)) > 0) {
+        for (uint16_t i = 0; i < count; i++) {
+            TEST_ASSERT_EQUAL_UINT32(LOG_START + total + 1, page[i].timestamp);
+            total++;
+        }
+    }
+    return total;
+}
+
+void setUp() {
+    fakeFlash.reset();
+}
+
+void tearDown() {}
+
+void test_legacy_block_at_segment_end() {
+    // 2-byte records: 119 full blocks and one of 10 fill the segment to
+    // 4092, leaving room for one last 1-record block that ends on the
+    // final byte. Its 2-byte header sits where a PBL3 CRC would overrun.
+    std::vector<uint8_t> blocks(119, EVENT_LOG_BATCH);
+    blocks.push_back(10);
+    blocks.push_back(1);
+    TEST_ASSERT_EQUAL_size_t(EVENT_LOG_SEGMENT_SIZE, writeLegacySegment(blocks));
+    
+    TEST_ASSERT_TRUE(eventLog.begin());
+    TEST_ASSERT_EQUAL_UINT32(119 * EVENT_LOG_BATCH + 11, readAll());
+    TEST_ASSERT_EQUAL_UINT32(0, eventLog.getDamagedBlocks());
+}
+
+void test_legacy_head_is_extended_in_current_format() {
+    writeLegacySegment({EVENT_LOG_BATCH, EVENT_LOG_BATCH, 5});
+    TEST_ASSERT_TRUE(eventLog.begin());
+    TEST_ASSERT_EQUAL_UINT32(37, eventLog.getCount());
+    
+    for (uint32_t i = 0; i < 40; i++) {
+        eventLog.append({LOG_START + 38 + i, 0, true});
+    }
+    eventLog.flush();
+    
+    // Remounted from flash alone
+    TEST_ASSERT_TRUE(eventLog.begin());
+    TEST_ASSERT_EQUAL_UINT32(77, readAll());
+    TEST_ASSERT_EQUAL_UINT32(0, eventLog.getDamagedBlocks());
+}
+
+void test_damaged_legacy_block_ends_segment() {
+    size_t used = writeLegacySegment({EVENT_LOG_BATCH, EVENT_LOG_BATCH});
+    fakeFlash.bytes[used - 3] ^= 0x10;     // Inside the second block
+    
+    TEST_ASSERT_TRUE(eventLog.begin());
+    TEST_ASSERT_EQUAL_UINT32(EVENT_LOG_BATCH, readAll());
+    TEST_ASSERT_TRUE(eventLog.getDamagedBlocks() > 0);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_legacy_block_at_segment_end);
+    RUN_TEST(test_legacy_head_is_extended_in_current_format);
+    RUN_TEST(test_damaged_legacy_block_ends_segment);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+/**
+ * @file test_main.cpp
+ * @brief HistoryCodec round-trip and throughput over a year of events
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "HistoryCodec.h"
+
+#define YEAR_START      1700000000UL
+#define RAW_RECORD_SIZE 8       // Fixed LogEntry records, before the codec
+#define THROUGHPUT_RUNS 200
+
+static std::vector<LogEntry> year;
+
+/**
+ * @brief Four doses a day for a year, taken up to 15 minutes late, plus
+ *        one lid opening in ten without a dose
+ */
+static void buildYear() {
+    srand(1);
+    year.clear();
+    
+    for (uint32_t day = 0; day < 365; day++) {
+        for (uint16_t dose = 0; dose < 4; dose++) {
+            LogEntry entry;
+            entry.timestamp = YEAR_START + day * 86400 + (8 + 4 * dose) * 3600 + rand() % 900;
+            entry.doseIndex = (rand() % 10 == 0) ? HISTORY_NO_DOSE : dose;
+            entry.wasOnTime = (rand() % 4) != 0;
+            year.push_back(entry);
+        }
+    }
+}
+
+static size_t encodeAll(const std::vector<LogEntry>& entries, std::vector<uint8_t>& out) {
+    out.resize(entries.size() * HISTORY_MAX_RECORD_SIZE);
+    size_t length = 0;
+    uint32_t previous = YEAR_START;
+    
+    for (const LogEntry& entry : entries) {
+        length += historyEncode(entry, previous, &out[length]);
+        previous = entry.timestamp;
+    }
+    
+    return length;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_year_round_trips() {
+    std::vector<uint8_t> encoded;
+    size_t length = encodeAll(year, encoded);
+    
+    size_t position = 0;
+    uint32_t previous = YEAR_START;
+    for (const LogEntry& expected : year) {
+        LogEntry entry;
+        size_t used = historyDecode(&encoded[position], length - position, previous, entry);
+        
+        TEST_ASSERT_TRUE(used > 0);
+        TEST_ASSERT_EQUAL_UINT32(expected.timestamp, entry.timestamp);
+        TEST_ASSERT_EQUAL_UINT16(expected.doseIndex, entry.doseIndex);
+        TEST_ASSERT_EQUAL(expected.wasOnTime, entry.wasOnTime);
+        
+        position += used;
+        previous = entry.timestamp;
+    }
+    TEST_ASSERT_EQUAL_size_t(length, position);
+    
+    // At least twice the history of the fixed 8-byte records
+    char message[96];
+    snprintf(message, sizeof(message), "%u records in %u bytes: %.2f bytes/record, %.1fx",
+             (unsigned)year.size(), (unsigned)length, (double)length / year.size(),
+             (double)(year.size() * RAW_RECORD_SIZE) / length);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_OR_EQUAL(year.size() * RAW_RECORD_SIZE / 2, length);
+}
+
+void test_edge_values_round_trip() {
+    const LogEntry entries[] = {
+        {100, 3, true},                         // Clock set backwards
+        {0xFFFFFFFF, 511, false},               // Largest step forward
+        {0, HISTORY_NO_DOSE, true},             // Wraps back to 0
+        {0, 0xFFFE, false},                     // Largest dose index
+        {0, 0, true},                           // Same second
+    };
+    uint8_t buffer[HISTORY_MAX_RECORD_SIZE];
+    uint32_t previous = YEAR_START;
+    
+    for (const LogEntry& expected : entries) {
+        size_t length = historyEncode(expected, previous, buffer);
+        TEST_ASSERT_LESS_OR_EQUAL(HISTORY_MAX_RECORD_SIZE, length);
+        
+        LogEntry entry;
+        TEST_ASSERT_EQUAL_size_t(length, historyDecode(buffer, length, previous, entry));
+        TEST_ASSERT_EQUAL_UINT32(expected.timestamp, entry.timestamp);
+        TEST_ASSERT_EQUAL_UINT16(expected.doseIndex, entry.doseIndex);
+        TEST_ASSERT_EQUAL(expected.wasOnTime, entry.wasOnTime);
+        previous = entry.timestamp;
+    }
+}
+
+void test_truncated_record_is_rejected() {
+    uint8_t buffer[HISTORY_MAX_RECORD_SIZE];
+    LogEntry entry = {YEAR_START + 86400 * 30, 300, true};
+    size_t length = historyEncode(entry, YEAR_START, buffer);
+    
+    for (size_t cut = 0; cut < length; cut++) {
+        LogEntry decoded;
+        TEST_ASSERT_EQUAL_size_t(0, historyDecode(buffer, cut, YEAR_START, decoded));
+    }
+}
+
+void test_throughput() {
+    std::vector<uint8_t> encoded;
+    size_t length = 0;
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < THROUGHPUT_RUNS; run++) {
+        length = encodeAll(year, encoded);
+    }
+    auto encodedAt = std::chrono::steady_clock::now();
+    
+    uint32_t checksum = 0;
+    for (int run = 0; run < THROUGHPUT_RUNS; run++) {
+        size_t position = 0;
+        uint32_t previous = YEAR_START;
+        LogEntry entry;
+        while (position < length) {
+            position += historyDecode(&encoded[position], length - position, previous, entry);
+            previous = entry.timestamp;
+            checksum += entry.doseIndex;
+        }
+    }
+    auto decodedAt = std::chrono::steady_clock::now();
+    
+    double records = (double)year.size() * THROUGHPUT_RUNS;
+    double encodeNs = std::chrono::duration<double, std::nano>(encodedAt - start).count();
+    double decodeNs = std::chrono::duration<double, std::nano>(decodedAt - encodedAt).count();
+    
+    char message[96];
+    snprintf(message, sizeof(message), "host: encode %.1f ns/record, decode %.1f ns/record",
+             encodeNs / records, decodeNs / records);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(checksum > 0);
+}
+
+int main() {
+    buildYear();
+    
+    UNITY_BEGIN();
+    RUN_TEST(test_year_round_trips);
+    RUN_TEST(test_edge_values_round_trip);
+    RUN_TEST(test_truncated_record_is_rejected);
+    RUN_TEST(test_throughput);
+    return UNITY_END();
+}
@@ -0,0 +1,182 @@
+/**
+ * @file test_main.cpp
+ * @brief GET /api/logs streamed reply: heap high-water and latency at 100, 10k and 100k records
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * Heap is tracked through the global operator new/delete, which is what
+ * the chunked response's std::function and a String-built reply use.
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Storage.h"
+#include "LogStream.h"
+
+#define LOG_START       1700000000U
+#define LOG_RECORDS     100000
+#define CHUNK_SIZE      1436        // Typical space AsyncTCP offers per fill
+
+// Live heap bytes and the most seen since the last heapMark()
+static size_t heapLive = 0;
+static size_t heapPeak = 0;
+
+void* operator new(size_t size) {
+    size_t* block = (size_t*)malloc(size + sizeof(size_t));
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    heapLive += size;
+    heapPeak = max(heapPeak, heapLive);
+    return block + 1;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (!pointer) return;
+    size_t* block = (size_t*)pointer - 1;
+    heapLive -= *block;
+    free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+static size_t heapMark() {
+    heapPeak = heapLive;
+    return heapLive;
+}
+
+static Storage storage;
+
+// Filler callback as handleGetLogs() hands it to beginChunkedResponse()
+typedef std::function<size_t(uint8_t*, size_t, size_t)> Filler;
+
+static Filler makeFiller(uint32_t id, uint32_t limit) {
+    LogStream stream(&storage, 0, UINT32_MAX, id, limit, false);
+    return [stream](uint8_t* buffer, size_t maxLen, size_t) mutable -> size_t {
+        return stream.fill(buffer, maxLen);
+    };
+}
+
+/**
+ * @brief The newest limit records, as GET /api/logs?limit= asks for them
+ */
+static uint32_t newestPage(uint32_t limit) {
+    uint32_t end = storage.getEventLog().getEndId();
+    return (end > limit) ? end - limit : 0;
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - since).count();
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_chunk_size_does_not_change_reply() {
+    std::string whole, bytewise;
+    uint8_t buffer[CHUNK_SIZE];
+    size_t length;
+    
+    Filler filler = makeFiller(newestPage(100), 100);
+    while ((length = filler(buffer, CHUNK_SIZE, whole.size())) > 0) {
+        whole.append((char*)buffer, length);
+    }
+    filler = makeFiller(newestPage(100), 100);
+    while ((length = filler(buffer, 1, bytewise.size())) > 0) {
+        bytewise.append((char*)buffer, length);
+    }
+    
+    TEST_ASSERT_EQUAL_STRING(whole.c_str(), bytewise.c_str());
+    TEST_ASSERT_EQUAL_INT(0, whole.find("{\"totalOpenings\":"));
+    
+    char tail[32];
+    snprintf(tail, sizeof(tail), "],\"next\":%lu}", (unsigned long)storage.getEventLog().getEndId());
+    TEST_ASSERT_EQUAL_STRING(tail, whole.c_str() + whole.size() - strlen(tail));
+}
+
+void test_heap_and_latency() {
+    static const uint32_t limits[] = {100, 10000, 100000};
+    size_t streamedPeaks[3];
+    
+    for (uint8_t i = 0; i < 3; i++) {
+        uint32_t limit = limits[i];
+        uint8_t buffer[CHUNK_SIZE];
+        size_t length;
+        
+        // Streamed: the filler is the only allocation
+        size_t base = heapMark();
+        auto start = std::chrono::steady_clock::now();
+        Filler filler = makeFiller(newestPage(limit), limit);
+        
+        size_t total = 0;
+        uint32_t records = 0;
+        uint32_t chunks = 0;
+        double firstUs = 0;
+        double worstUs = 0;
+        auto chunkStart = std::chrono::steady_clock::now();
+        while ((length = filler(buffer, CHUNK_SIZE, total)) > 0) {
+            double chunkUs = elapsedUs(chunkStart);
+            if (chunks == 0) firstUs = elapsedUs(start);
+            worstUs = max(worstUs, chunkUs);
+            for (size_t j = 0; j < length; j++) {
+                records += buffer[j] == '{';
+            }
+            total += length;
+            chunks++;
+            chunkStart = std::chrono::steady_clock::now();
+        }
+        double totalUs = elapsedUs(start);
+        records--;      // The enclosing object
+        streamedPeaks[i] = heapPeak - base;
+        filler = nullptr;
+        
+        // Buffered: the same reply built up in one string first
+        base = heapMark();
+        {
+            std::string reply;
+            Filler builder = makeFiller(newestPage(limit), limit);
+            while ((length = builder(buffer, CHUNK_SIZE, reply.size())) > 0) {
+                reply.append((char*)buffer, length);
+            }
+        }
+        size_t bufferedPeak = heapPeak - base;
+        
+        char message[200];
+        snprintf(message, sizeof(message),
+                 "host, limit %6u: %6u records, %7u bytes in %4u chunks, first %5.1f us, "
+                 "worst chunk %5.1f us, %6.1f MB/s | heap streamed %u B, buffered %7u B",
+                 limit, records, (unsigned)total, chunks, firstUs, worstUs, total / totalUs,
+                 (unsigned)streamedPeaks[i], (unsigned)bufferedPeak);
+        TEST_MESSAGE(message);
+        
+        TEST_ASSERT_EQUAL_UINT32(min(limit, storage.getEventLog().getCount()), records);
+        TEST_ASSERT_TRUE(bufferedPeak > total);
+    }
+    
+    // Peak heap does not depend on the number of records sent
+    TEST_ASSERT_EQUAL_size_t(streamedPeaks[0], streamedPeaks[1]);
+    TEST_ASSERT_EQUAL_size_t(streamedPeaks[0], streamedPeaks[2]);
+    TEST_ASSERT_TRUE(streamedPeaks[0] <= sizeof(LogStream) + 64);
+}
+
+int main() {
+    fakeFlash.reset();
+    storage.begin();
+    
+    // A lid opening every 10 minutes: about two years of history
+    for (uint32_t i = 0; i < LOG_RECORDS; i++) {
+        storage.logLidOpening(LOG_START + i * 600, (i % 7 == 0) ? -1 : i % 5, i & 1);
+    }
+    storage.flush();
+    
+    UNITY_BEGIN();
+    RUN_TEST(test_chunk_size_does_not_change_reply);
+    RUN_TEST(test_heap_and_latency);
+    return UNITY_END();
+}
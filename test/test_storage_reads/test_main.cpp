@@ -0,0 +1,320 @@
+/**
+ * @file test_main.cpp
+ * @brief NVS reads and writes of the Storage RAM shadow against the old per-call reads
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ *
+ * Operations are counted by the fake Preferences, independently of
+ * Storage's own nvs counters (which are checked against them).
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "Storage.h"
+
+#define BENCH_RUNS      1000
+
+static const uint16_t sizes[] = {3, MAX_DOSES};
+
+/**
+ * @brief Storage hot paths before the RAM shadow: every call went to NVS
+ *        for the keys it needed. Kept in the v4 format (one CRC-8 key for
+ *        the whole blob) that they were written for.
+ */
+class OldStorage {
+public:
+    void begin() {
+        prefs.begin("old", false);
+        
+        if (prefs.getUChar("version", 0) == 0) {
+            prefs.putUChar("version", STORAGE_VERSION);
+            prefs.putBool("alarmEn", true);
+            prefs.putBool("muteMode", false);
+            prefs.putUChar("lastDay", 0);
+        }
+        
+        // Settings were already kept in RAM
+        alarmEnabled = prefs.getBool("alarmEn", true);
+        muteMode = prefs.getBool("muteMode", false);
+    }
+    
+    void saveDoses(const DoseTable& doses, uint16_t day) {
+        for (uint16_t i = 0; i < doses.count; i++) {
+            buffer[i * DOSE_RECORD_SIZE] = doses.minutes[i] & 0xFF;
+            buffer[i * DOSE_RECORD_SIZE + 1] = doses.minutes[i] >> 8;
+            buffer[i * DOSE_RECORD_SIZE + 2] = doses.flags[i] | (doses.compartments[i] << 4);
+        }
+        
+        prefs.putBytes("doses", buffer, doses.count * DOSE_RECORD_SIZE);
+        prefs.putUChar("crc", crc8(buffer, doses.count * DOSE_RECORD_SIZE));
+        if (prefs.getUShort("takenDay", 0) != day) {
+            prefs.putUShort("takenDay", day);
+        }
+    }
+    
+    uint16_t loadDoses(DoseTable& doses, uint16_t today) {
+        size_t length = prefs.getBytesLength("doses");
+        uint16_t count = length / DOSE_RECORD_SIZE;
+        if (count == 0 || count > MAX_DOSES) return 0;
+        
+        if (prefs.getBytes("doses", buffer, length) != length ||
+            prefs.getUChar("crc", 0) != crc8(buffer, length)) {
+            return 0;
+        }
+        
+        bool keepTaken = prefs.getUShort("takenDay", 0) == today;
+        for (uint16_t i = 0; i < count; i++) {
+            doses.minutes[i] = buffer[i * DOSE_RECORD_SIZE] | (buffer[i * DOSE_RECORD_SIZE + 1] << 8);
+            doses.flags[i] = buffer[i * DOSE_RECORD_SIZE + 2] & (keepTaken ? 0x03 : 0x01);
+            doses.compartments[i] = buffer[i * DOSE_RECORD_SIZE + 2] >> 4;
+        }
+        return count;
+    }
+    
+    void loadSettings(bool& alarm, bool& mute) {
+        alarm = alarmEnabled;
+        mute = muteMode;
+    }
+    
+    void saveLastDay(uint8_t day) {
+        prefs.putUChar("lastDay", day);
+    }
+    
+    uint8_t loadLastDay() {
+        return prefs.getUChar("lastDay", 0);
+    }
+    
+    uint8_t getVersion() {
+        return prefs.getUChar("version", 0);
+    }
+    
+    bool verifyIntegrity() {
+        size_t length = prefs.getBytesLength("doses");
+        if (length == 0) return true;
+        if (length > sizeof(buffer) || length % DOSE_RECORD_SIZE != 0) return false;
+        if (prefs.getBytes("doses", buffer, length) != length) return false;
+        return prefs.getUChar("crc", 0) == crc8(buffer, length);
+    }
+
+private:
+    Preferences prefs;
+    bool alarmEnabled;
+    bool muteMode;
+    uint8_t buffer[MAX_DOSES * DOSE_RECORD_SIZE];
+    
+    static uint8_t crc8(const uint8_t* data, size_t length) {
+        uint8_t crc = 0;
+        
+        for (size_t i = 0; i < length; i++) {
+            crc ^= data[i];
+            for (uint8_t j = 0; j < 8; j++) {
+                crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+            }
+        }
+        
+        return crc;
+    }
+};
+
+static Storage storage;
+static OldStorage oldStorage;
+static DoseTable table;
+
+// NVS operations counted by the fake since the last mark
+struct Ops {
+    uint32_t reads;
+    uint32_t writes;
+};
+
+static Ops mark = {};
+
+static Ops since() {
+    Ops ops = {fakeNvs.reads - mark.reads, fakeNvs.writes - mark.writes};
+    mark = {fakeNvs.reads, fakeNvs.writes};
+    return ops;
+}
+
+static void fillTable(uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        table.minutes[i] = i * 2;
+        table.flags[i] = DOSE_FLAG_ENABLED;
+        table.compartments[i] = i % MAX_COMPARTMENTS;
+    }
+    table.count = count;
+}
+
+static void reportOps(const char* name, uint16_t count, Ops before, Ops after) {
+    char message[128];
+    snprintf(message, sizeof(message), "%3u doses, %-22s reads %2u -> %u, writes %u -> %u",
+             count, name, before.reads, after.reads, before.writes, after.writes);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(after.reads <= before.reads);
+    TEST_ASSERT_TRUE(after.writes <= before.writes);
+}
+
+/**
+ * @brief Run one firmware step on both implementations and report it
+ */
+template <typename Step, typename OldStep>
+static void compare(const char* name, uint16_t count, Step step, OldStep oldStep) {
+    since();
+    oldStep();
+    Ops before = since();
+    step();
+    Ops after = since();
+    reportOps(name, count, before, after);
+}
+
+/**
+ * @brief Both stores as a device leaves them: schedule saved today,
+ *        day 5 of the month
+ */
+static void prepare(uint16_t count) {
+    fakeNvs.reset();
+    fakeFlash.reset();
+    fillTable(count);
+    
+    oldStorage.begin();
+    oldStorage.saveDoses(table, 100);
+    oldStorage.saveLastDay(5);
+    
+    storage.begin();
+    storage.saveDoses(table, 100);
+    storage.saveLastDay(5);
+    mark = {fakeNvs.reads, fakeNvs.writes};
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_operations_per_call() {
+    for (uint16_t count : sizes) {
+        prepare(count);
+        bool alarm, mute;
+        
+        // Boot as setup() does it
+        compare("boot", count, [&] {
+            storage.begin();
+            storage.loadSettings(alarm, mute);
+            storage.loadDoses(table, 100);
+            storage.loadLastDay();
+        }, [&] {
+            oldStorage.begin();
+            oldStorage.loadSettings(alarm, mute);
+            oldStorage.loadDoses(table, 100);
+            oldStorage.loadLastDay();
+        });
+        TEST_ASSERT_EQUAL_UINT8(5, storage.loadLastDay());
+        
+        table.flags[0] |= DOSE_FLAG_TAKEN;
+        compare("dose taken", count, [&] { storage.saveDoses(table, 100); },
+                [&] { oldStorage.saveDoses(table, 100); });
+        
+        table.flags[0] &= ~DOSE_FLAG_TAKEN;
+        compare("midnight", count, [&] {
+            storage.saveDoses(table, 101);
+            storage.saveLastDay(6);
+        }, [&] {
+            oldStorage.saveDoses(table, 101);
+            oldStorage.saveLastDay(6);
+        });
+        
+        // checkMidnightReset() on a restart the same day
+        compare("saveLastDay unchanged", count, [&] { storage.saveLastDay(6); },
+                [&] { oldStorage.saveLastDay(6); });
+        compare("loadLastDay", count, [&] { storage.loadLastDay(); },
+                [&] { oldStorage.loadLastDay(); });
+        compare("getVersion", count, [&] { storage.getVersion(); },
+                [&] { oldStorage.getVersion(); });
+        compare("verifyIntegrity", count, [&] { TEST_ASSERT_TRUE(storage.verifyIntegrity()); },
+                [&] { TEST_ASSERT_TRUE(oldStorage.verifyIntegrity()); });
+    }
+}
+
+void test_a_day_of_use() {
+    // What the firmware does with Storage in a day: boot, three doses
+    // taken, midnight
+    for (uint16_t count : sizes) {
+        prepare(count);
+        bool alarm, mute;
+        
+        compare("day", count, [&] {
+            storage.begin();
+            storage.loadSettings(alarm, mute);
+            storage.loadDoses(table, 100);
+            storage.loadLastDay();
+            for (uint8_t i = 0; i < 3; i++) {
+                table.flags[i % table.count] |= DOSE_FLAG_TAKEN;
+                storage.saveDoses(table, 100);
+            }
+            storage.saveDoses(table, 101);
+            storage.saveLastDay(6);
+        }, [&] {
+            oldStorage.begin();
+            oldStorage.loadSettings(alarm, mute);
+            oldStorage.loadDoses(table, 100);
+            oldStorage.loadLastDay();
+            for (uint8_t i = 0; i < 3; i++) {
+                table.flags[i % table.count] |= DOSE_FLAG_TAKEN;
+                oldStorage.saveDoses(table, 100);
+            }
+            oldStorage.saveDoses(table, 101);
+            oldStorage.saveLastDay(6);
+        });
+    }
+}
+
+void test_nvs_stats_match_counted_operations() {
+    prepare(MAX_DOSES);
+    
+    // begin() clears the stats; the counted operations after it must match
+    storage.begin();
+    since();
+    storage.loadDoses(table, 100);
+    storage.saveDoses(table, 101);
+    storage.saveLastDay(7);
+    storage.verifyIntegrity();
+    Ops counted = since();
+    
+    TEST_ASSERT_EQUAL_UINT32(counted.reads, storage.getNvsStats().reads);
+    TEST_ASSERT_EQUAL_UINT32(counted.writes, storage.getNvsStats().writes);
+}
+
+void test_read_time() {
+    // Host time of the read-only calls, fake NVS lookups included
+    for (uint16_t count : sizes) {
+        prepare(count);
+        storage.begin();
+        oldStorage.begin();
+        
+        volatile uint32_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            sink += oldStorage.verifyIntegrity() + oldStorage.getVersion() + oldStorage.loadLastDay();
+        }
+        double oldNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_RUNS;
+        
+        start = std::chrono::steady_clock::now();
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            sink += storage.verifyIntegrity() + storage.getVersion() + storage.loadLastDay();
+        }
+        double newNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_RUNS;
+        
+        char message[128];
+        snprintf(message, sizeof(message),
+                 "host, %3u doses: verifyIntegrity + getVersion + loadLastDay %8.1f -> %5.1f ns",
+                 count, oldNs, newNs);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_TRUE(sink != 0);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_operations_per_call);
+    RUN_TEST(test_a_day_of_use);
+    RUN_TEST(test_nvs_stats_match_counted_operations);
+    RUN_TEST(test_read_time);
+    return UNITY_END();
+}
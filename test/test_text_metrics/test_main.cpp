@@ -0,0 +1,150 @@
+/**
+ * @file test_main.cpp
+ * @brief Text widths against GFX getTextBounds(), with a per-frame benchmark
+ * @project Smart Pill Box with ESP32
+ * @version 1.0
+ */
+
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "TextMetrics.h"
+
+#define DISPLAY_WIDTH   128     // SCREEN_WIDTH
+#define BENCH_FRAMES    200000
+
+/**
+ * @brief Adafruit_GFX::charBounds() for the built-in font (GFX 1.11),
+ *        text wrap on as UIManager leaves it
+ */
+static void charBounds(unsigned char c, int16_t* x, int16_t* y, int16_t* minx,
+                       int16_t* miny, int16_t* maxx, int16_t* maxy, uint8_t size) {
+    if (c == '\n') {
+        *x = 0;
+        *y += size * 8;
+    } else if (c != '\r') {
+        if ((*x + size * 6) > DISPLAY_WIDTH) {
+            *x = 0;
+            *y += size * 8;
+        }
+        int x2 = *x + size * 6 - 1, y2 = *y + size * 8 - 1;
+        if (x2 > *maxx) *maxx = x2;
+        if (y2 > *maxy) *maxy = y2;
+        if (*x < *minx) *minx = *x;
+        if (*y < *miny) *miny = *y;
+        *x += size * 6;
+    }
+}
+
+/**
+ * @brief Adafruit_GFX::getTextBounds() (GFX 1.11), width only
+ */
+__attribute__((noinline))
+static uint16_t getTextBoundsWidth(const char* str, uint8_t size) {
+    int16_t x = 0, y = 0;
+    int16_t minx = 0x7FFF, miny = 0x7FFF, maxx = -1, maxy = -1;
+    uint8_t c;
+    
+    while ((c = *str++)) {
+        charBounds(c, &x, &y, &minx, &miny, &maxx, &maxy, size);
+    }
+    
+    return (maxx >= minx) ? maxx - minx + 1 : 0;
+}
+
+struct Sample {
+    const char* text;
+    uint8_t size;
+};
+
+// Strings drawCenteredText() measures, fixed and formatted
+static const Sample samples[] = {
+    {"No doses scheduled", 1}, {"DOSE SETTINGS", 1}, {"NEXT:Change OK:Save", 1},
+    {"OK:Toggle BACK:Exit", 1}, {"ON", 2}, {"OFF", 2}, {"TAKE", 2}, {"MEDICINE", 2},
+    {"Open lid to take dose", 1}, {"Next: 3h 25m", 1}, {"Next: 12 min", 1},
+    {"Today: 2/4", 1}, {"Today: 128/512", 1}, {"08:00 AM", 1}, {"4:59", 2},
+    {"192.168.4.1", 1}, {"", 1}, {"two\nlines here", 1}, {"cr\r\nlf", 2},
+    // Wider than the display: GFX wraps, so both cap at whole cells
+    {"Dose could not be saved to storage", 1}, {"MEDICINE NOW", 2},
+};
+
+struct FrameLine {
+    const char* text;
+    uint8_t size;
+    bool fixed;             // FixedText: width known at compile time
+};
+
+// The centred strings getTextBounds() measured on each redraw of a screen
+struct Frame {
+    const char* name;
+    FrameLine lines[3];
+    uint8_t count;
+};
+
+static const Frame frames[] = {
+    {"home", {{"Next: 3h 25m", 1, false}, {"Today: 2/4", 1, false}}, 2},
+    {"alert", {{"TAKE", 2, true}, {"MEDICINE", 2, true}, {"08:00 AM", 1, false}}, 3},
+    {"snooze", {{"SNOOZED", 1, true}, {"4:59", 2, false}, {"Open lid to take dose", 1, true}}, 3},
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_widths_match_get_text_bounds() {
+    for (const Sample& sample : samples) {
+        char message[64];
+        snprintf(message, sizeof(message), "\"%s\" at size %u", sample.text, sample.size);
+        TEST_ASSERT_EQUAL_INT_MESSAGE(getTextBoundsWidth(sample.text, sample.size),
+                                      textWidth(sample.text, sample.size, DISPLAY_WIDTH),
+                                      message);
+    }
+}
+
+void test_fixed_text_widths_are_compile_time() {
+    static constexpr FixedText title("DOSE SETTINGS", 1);
+    static constexpr FixedText alert("MEDICINE", 2);
+    static_assert(title.width == 13 * FONT_CHAR_WIDTH, "width folded at compile time");
+    
+    TEST_ASSERT_EQUAL_INT(getTextBoundsWidth(title.text, title.size), title.width);
+    TEST_ASSERT_EQUAL_INT(getTextBoundsWidth(alert.text, alert.size), alert.width);
+}
+
+void test_per_frame_cost() {
+    // Fixed lines cost a constant load now, counted as nothing
+    for (const Frame& frame : frames) {
+        volatile int32_t sink = 0;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++) {
+            for (uint8_t line = 0; line < frame.count; line++) {
+                sink += getTextBoundsWidth(frame.lines[line].text, frame.lines[line].size);
+            }
+        }
+        auto gfxAt = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < BENCH_FRAMES; i++) {
+            for (uint8_t line = 0; line < frame.count; line++) {
+                const FrameLine& text = frame.lines[line];
+                sink += text.fixed ? FONT_CHAR_WIDTH : textWidth(text.text, text.size, DISPLAY_WIDTH);
+            }
+        }
+        auto countedAt = std::chrono::steady_clock::now();
+        
+        double gfxNs = std::chrono::duration<double, std::nano>(gfxAt - start).count() / BENCH_FRAMES;
+        double countedNs = std::chrono::duration<double, std::nano>(countedAt - gfxAt).count() / BENCH_FRAMES;
+        
+        char message[128];
+        snprintf(message, sizeof(message),
+                 "host, %s frame: getTextBounds %.1f ns, textWidth %.1f ns, saved %.1f ns",
+                 frame.name, gfxNs, countedNs, gfxNs - countedNs);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_TRUE(sink > 0);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_widths_match_get_text_bounds);
+    RUN_TEST(test_fixed_text_widths_are_compile_time);
+    RUN_TEST(test_per_frame_cost);
+    return UNITY_END();
+}
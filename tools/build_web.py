@@ -0,0 +1,81 @@
+"""
+Build the web UI filesystem image contents.
+
+Minifies and gzips every file in web/ into data/<name>.gz and writes
+data/etags.txt, one "<path> <etag>" line per asset. The firmware reads
+the manifest at startup, serves the .gz files with Content-Encoding:
+gzip and a strong ETag (a hash of the gzipped bytes), and answers
+matching If-None-Match requests with 304 without touching flash.
+
+Runs before every PlatformIO build (extra_scripts = pre:...), so
+`pio run -t uploadfs` always ships the current web/ sources. Can also be
+run directly: python tools/build_web.py
+"""
+
+import gzip
+import hashlib
+import os
+import re
+
+MANIFEST = "etags.txt"
+
+
+def minify_html(text):
+    """Conservative minify: keeps line breaks so scripts parse unchanged."""
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    lines = []
+    in_script = False
+    for line in text.splitlines():
+        line = line.strip()
+        if "<script" in line:
+            in_script = True
+        if "</script>" in line:
+            in_script = False
+        if not line or (in_script and line.startswith("//")):
+            continue
+        lines.append(line)
+    return "\n".join(lines) + "\n"
+
+
+def minify(name, data):
+    if name.endswith((".html", ".htm")):
+        return minify_html(data.decode("utf-8")).encode("utf-8")
+    return data
+
+
+def build(root):
+    source_dir = os.path.join(root, "web")
+    output_dir = os.path.join(root, "data")
+    os.makedirs(output_dir, exist_ok=True)
+
+    # Drop outputs of assets that no longer exist
+    for name in os.listdir(output_dir):
+        if name.endswith(".gz") or name == MANIFEST:
+            os.remove(os.path.join(output_dir, name))
+
+    manifest = []
+    for name in sorted(os.listdir(source_dir)):
+        with open(os.path.join(source_dir, name), "rb") as f:
+            source = f.read()
+
+        # mtime=0 keeps the output, and so the ETag, stable across builds
+        packed = gzip.compress(minify(name, source), compresslevel=9, mtime=0)
+        with open(os.path.join(output_dir, name + ".gz"), "wb") as f:
+            f.write(packed)
+
+        etag = hashlib.sha256(packed).hexdigest()[:16]
+        manifest.append("/%s %s\n" % (name, etag))
+        print("web: %s %d -> %d bytes (gzip), etag %s" % (name, len(source), len(packed), etag))
+
+    with open(os.path.join(output_dir, MANIFEST), "w") as f:
+        f.writelines(manifest)
+
+
+try:
+    Import("env")  # noqa: F821 (PlatformIO pre-script)
+    # SCons runs pre-scripts without __file__
+    root = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+build(root)